@@ -0,0 +1,307 @@
+// Converts a product list to the binary catalog the store maps at startup:
+//
+//   CatalogTool products.csv products.bin [--currency DT] [--pad COUNT]
+//   CatalogTool products.json products.bin
+//
+// CSV input starts with a header row naming the columns; JSON input is an
+// array of flat objects. Either way the fields are name, price, seller,
+// category and image, and columns or keys with other names are ignored.
+// Prices are decimal text such as "129.99" or "129.99 DT". --pad repeats the
+// products under new names until the catalog holds COUNT of them, for trying
+// the store at sizes no real list has yet.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../Common/catalog.h"
+
+struct SourceProduct {
+	std::string name, price, seller, category, image;
+};
+
+static bool SetField(SourceProduct& product, const std::string& field, const std::string& value) {
+	if (field == "name") product.name = value;
+	else if (field == "price") product.price = value;
+	else if (field == "seller") product.seller = value;
+	else if (field == "category") product.category = value;
+	else if (field == "image") product.image = value;
+	else return false;
+	return true;
+}
+
+static bool ReadFile(const char* path, std::string& text) {
+	std::ifstream in(path, std::ios::binary);
+	if (!in) return false;
+	std::ostringstream contents;
+	contents << in.rdbuf();
+	text = contents.str();
+	// Spreadsheet exports often start with a byte order mark
+	if (text.compare(0, 3, "\xEF\xBB\xBF") == 0) text.erase(0, 3);
+	return true;
+}
+
+// Splits RFC 4180 CSV: fields in double quotes may hold commas, line breaks
+// and "" for a quote
+static bool ParseCsv(const std::string& text, std::vector<std::vector<std::string>>& records) {
+	std::vector<std::string> record;
+	std::string field;
+	size_t i = 0;
+	while (i < text.size()) {
+		if (text[i] == '"' && field.empty()) {
+			for (i++;; i++) {
+				if (i >= text.size()) {
+					std::cerr << "ERROR::CATALOGTOOL::UNTERMINATED_QUOTE in record " << records.size() + 1 << std::endl;
+					return false;
+				}
+				if (text[i] == '"') {
+					if (i + 1 < text.size() && text[i + 1] == '"') i++;
+					else break;
+				}
+				field += text[i];
+			}
+			i++;
+			continue;
+		}
+		if (text[i] == ',') {
+			record.push_back(field);
+			field.clear();
+		}
+		else if (text[i] == '\n' || text[i] == '\r') {
+			if (text[i] == '\r' && i + 1 < text.size() && text[i + 1] == '\n') i++;
+			record.push_back(field);
+			field.clear();
+			// Blank lines separate nothing
+			if (record.size() > 1 || !record[0].empty()) records.push_back(record);
+			record.clear();
+		}
+		else {
+			field += text[i];
+		}
+		i++;
+	}
+	if (!field.empty() || !record.empty()) {
+		record.push_back(field);
+		records.push_back(record);
+	}
+	return true;
+}
+
+static bool LoadCsv(const std::string& text, std::vector<SourceProduct>& products) {
+	std::vector<std::vector<std::string>> records;
+	if (!ParseCsv(text, records)) return false;
+	if (records.empty()) {
+		std::cerr << "ERROR::CATALOGTOOL::MISSING_HEADER" << std::endl;
+		return false;
+	}
+	const std::vector<std::string>& header = records[0];
+	for (size_t r = 1; r < records.size(); r++) {
+		SourceProduct product;
+		for (size_t column = 0; column < header.size() && column < records[r].size(); column++) {
+			SetField(product, header[column], records[r][column]);
+		}
+		products.push_back(product);
+	}
+	return true;
+}
+
+// Just enough JSON for an array of flat objects; numbers are kept as their
+// text so prices never pass through a double
+class JsonReader {
+public:
+	explicit JsonReader(const std::string& source) : text(source), at(0) {}
+
+	bool ReadProducts(std::vector<SourceProduct>& products) {
+		if (!Expect('[')) return false;
+		if (Peek() == ']') return Expect(']');
+		do {
+			SourceProduct product;
+			if (!ReadObject(product)) return false;
+			products.push_back(product);
+		} while (Accept(','));
+		if (!Expect(']')) return false;
+		SkipSpace();
+		return at == text.size() || Fail("trailing characters");
+	}
+
+private:
+	bool ReadObject(SourceProduct& product) {
+		if (!Expect('{')) return false;
+		if (Peek() == '}') return Expect('}');
+		do {
+			std::string key, value;
+			if (!ReadString(key) || !Expect(':') || !ReadValue(value)) return false;
+			SetField(product, key, value);
+		} while (Accept(','));
+		return Expect('}');
+	}
+
+	bool ReadValue(std::string& value) {
+		char c = Peek();
+		if (c == '"') return ReadString(value);
+		if (c == '-' || (c >= '0' && c <= '9')) {
+			size_t start = at;
+			while (at < text.size() && std::strchr("+-.0123456789eE", text[at])) at++;
+			value.assign(text, start, at - start);
+			return true;
+		}
+		return Fail("expected a string or a number");
+	}
+
+	bool ReadString(std::string& value) {
+		if (!Expect('"')) return false;
+		while (at < text.size() && text[at] != '"') {
+			char c = text[at++];
+			if (c != '\\') {
+				value += c;
+				continue;
+			}
+			if (at >= text.size()) break;
+			char escape = text[at++];
+			switch (escape) {
+			case 'b': value += '\b'; break;
+			case 'f': value += '\f'; break;
+			case 'n': value += '\n'; break;
+			case 'r': value += '\r'; break;
+			case 't': value += '\t'; break;
+			case 'u': {
+				unsigned int cp;
+				if (!ReadHex(cp)) return false;
+				// A high surrogate is followed by the low half of the pair
+				if (cp >= 0xD800 && cp < 0xDC00) {
+					unsigned int low;
+					if (text.compare(at, 2, "\\u") != 0) return Fail("unpaired surrogate");
+					at += 2;
+					if (!ReadHex(low) || low < 0xDC00 || low >= 0xE000) return Fail("unpaired surrogate");
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+				}
+				AppendUtf8(value, cp);
+				break;
+			}
+			default: value += escape; break;
+			}
+		}
+		if (at >= text.size()) return Fail("unterminated string");
+		at++;
+		return true;
+	}
+
+	bool ReadHex(unsigned int& cp) {
+		if (at + 4 > text.size()) return Fail("truncated \\u escape");
+		char digits[5] = { text[at], text[at + 1], text[at + 2], text[at + 3], 0 };
+		char* end;
+		cp = static_cast<unsigned int>(std::strtoul(digits, &end, 16));
+		if (end != digits + 4) return Fail("bad \\u escape");
+		at += 4;
+		return true;
+	}
+
+	static void AppendUtf8(std::string& out, unsigned int cp) {
+		if (cp < 0x80) {
+			out += static_cast<char>(cp);
+		}
+		else if (cp < 0x800) {
+			out += static_cast<char>(0xC0 | (cp >> 6));
+			out += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else if (cp < 0x10000) {
+			out += static_cast<char>(0xE0 | (cp >> 12));
+			out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+		else {
+			out += static_cast<char>(0xF0 | (cp >> 18));
+			out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (cp & 0x3F));
+		}
+	}
+
+	void SkipSpace() {
+		while (at < text.size() && std::strchr(" \t\r\n", text[at])) at++;
+	}
+	char Peek() {
+		SkipSpace();
+		return at < text.size() ? text[at] : 0;
+	}
+	bool Accept(char c) {
+		if (Peek() != c) return false;
+		at++;
+		return true;
+	}
+	bool Expect(char c) {
+		if (Accept(c)) return true;
+		std::string message = "expected '";
+		return Fail((message + c + "'").c_str());
+	}
+	bool Fail(const char* message) {
+		std::cerr << "ERROR::CATALOGTOOL::JSON " << message << " at byte " << at << std::endl;
+		return false;
+	}
+
+	const std::string& text;
+	size_t at;
+};
+
+static bool EndsWith(const std::string& text, const char* suffix) {
+	size_t length = std::strlen(suffix);
+	return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+int main(int argc, char** argv) {
+	std::string input, output, currency = "DT";
+	size_t pad = 0;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--currency" && i + 1 < argc) currency = argv[++i];
+		else if (arg == "--pad" && i + 1 < argc) pad = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10));
+		else if (input.empty()) input = arg;
+		else if (output.empty()) output = arg;
+		else input.clear();
+	}
+	if (input.empty() || output.empty()) {
+		std::cerr << "usage: CatalogTool input.csv|input.json output.bin [--currency DT] [--pad COUNT]" << std::endl;
+		return 1;
+	}
+
+	std::string text;
+	if (!ReadFile(input.c_str(), text)) {
+		std::cerr << "ERROR::CATALOGTOOL::CANNOT_READ " << input << std::endl;
+		return 1;
+	}
+	std::vector<SourceProduct> products;
+	bool json = EndsWith(input, ".json") || EndsWith(input, ".JSON");
+	if (json ? !JsonReader(text).ReadProducts(products) : !LoadCsv(text, products)) return 1;
+
+	CatalogBuilder builder;
+	builder.SetCurrency(currency);
+	std::vector<uint32_t> prices(products.size());
+	for (size_t i = 0; i < products.size(); i++) {
+		const SourceProduct& product = products[i];
+		if (product.name.empty() || !ParsePrice(product.price, prices[i])) {
+			std::cerr << "ERROR::CATALOGTOOL::BAD_PRODUCT " << i + 1 << ": name \"" << product.name << "\", price \""
+				<< product.price << "\"" << std::endl;
+			return 1;
+		}
+		builder.Add(product.name, prices[i], product.seller, product.category, product.image);
+	}
+
+	static const char* const styles[] = { "Compact", "Portable", "Classic", "Smart", "Ergonomic", "Premium", "Mini", "Pro" };
+	for (size_t i = 0; builder.Count() < pad && !products.empty(); i++) {
+		const SourceProduct& product = products[i % products.size()];
+		std::string name = std::string(styles[(i / products.size()) % 8]) + " " + product.name;
+		// Vary the price a little so sorting has something to do
+		uint32_t price = prices[i % products.size()] + static_cast<uint32_t>((i * 37) % 280) * 100;
+		builder.Add(name, price, product.seller, product.category, product.image);
+	}
+
+	if (!builder.Save(output.c_str())) {
+		std::cerr << "ERROR::CATALOGTOOL::CANNOT_WRITE " << output << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << builder.Count() << " products to " << output << std::endl;
+	return 0;
+}
@@ -0,0 +1,360 @@
+#include "batch.h"
+#include "glstate.h"
+#include "trace.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Items are binned into a grid of cells this size, so each one is only
+// tested against earlier items sharing a cell with it. The cells grow when
+// the items spread further than kMaxGridCells of them in either direction.
+static const float kGridCellSize = 64.0f;
+static const int kMaxGridCells = 64;
+
+enum BatchItemKind {
+	BATCH_QUAD,
+	BATCH_ROUNDED_RECT
+};
+
+struct BatchItem {
+	unsigned int program;
+	unsigned int texture;
+	BatchItemKind kind;
+	float minX, minY, maxX, maxY;
+	int depth;
+	unsigned int dataIndex; // first vertex in quadVertices, or index in rectInstances
+};
+
+struct RoundedRectInstance {
+	float x, y, width, height;
+	float r, g, b, a;
+	float radius;
+};
+
+static std::vector<BatchItem> queuedItems;
+static std::vector<BatchVertex> quadVertices;
+static std::vector<RoundedRectInstance> rectInstances;
+static std::vector<unsigned int> drawOrder;
+static std::vector<std::vector<unsigned int>> gridCells; // queued items touching each cell
+static std::vector<unsigned int> lastTested;              // per item, the last item tested against it
+static std::vector<BatchVertex> uploadVertices;
+static std::vector<RoundedRectInstance> uploadInstances;
+
+static unsigned int batchVAO = 0, batchVBO = 0, batchEBO = 0;
+static unsigned int rectVAO = 0, rectCornerVBO = 0, rectInstanceVBO = 0;
+static unsigned int whiteTexture = 0;
+static size_t vertexCapacity = 0;   // in quads
+static size_t indexCapacity = 0;    // in quads
+static size_t instanceCapacity = 0; // in rounded rects
+
+static void EnsureIndexCapacity(size_t quadCount) {
+	if (quadCount <= indexCapacity) return;
+
+	size_t capacity = indexCapacity ? indexCapacity : 256;
+	while (capacity < quadCount) capacity *= 2;
+
+	std::vector<unsigned int> indices(capacity * 6);
+	for (size_t i = 0; i < capacity; i++) {
+		unsigned int base = static_cast<unsigned int>(i * 4);
+		indices[i * 6 + 0] = base + 0;
+		indices[i * 6 + 1] = base + 1;
+		indices[i * 6 + 2] = base + 2;
+		indices[i * 6 + 3] = base + 0;
+		indices[i * 6 + 4] = base + 2;
+		indices[i * 6 + 5] = base + 3;
+	}
+
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, batchEBO);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+	indexCapacity = capacity;
+}
+
+// Per-instance attributes start at `firstInstance`, since GL 3.3 has no base instance draw
+static void BindRectInstances(size_t firstInstance) {
+	const size_t stride = sizeof(RoundedRectInstance);
+	const size_t base = firstInstance * stride;
+	glBindBuffer(GL_ARRAY_BUFFER, rectInstanceVBO);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base));
+	glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, stride, (void*)(base + 4 * sizeof(float)));
+	glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void*)(base + 8 * sizeof(float)));
+}
+
+void InitBatchRenderer() {
+	glGenVertexArrays(1, &batchVAO);
+	glGenBuffers(1, &batchVBO);
+	glGenBuffers(1, &batchEBO);
+
+	BindVertexArray(batchVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, batchVBO);
+	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(BatchVertex), (void*)(4 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	EnsureIndexCapacity(256);
+
+	// Rounded rects: a unit quad per vertex, everything else per instance
+	float corners[] = {
+		0.0f, 0.0f,
+		1.0f, 0.0f,
+		0.0f, 1.0f,
+		1.0f, 1.0f
+	};
+	glGenVertexArrays(1, &rectVAO);
+	glGenBuffers(1, &rectCornerVBO);
+	glGenBuffers(1, &rectInstanceVBO);
+	BindVertexArray(rectVAO);
+	glBindBuffer(GL_ARRAY_BUFFER, rectCornerVBO);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	BindRectInstances(0);
+	for (unsigned int attribute = 1; attribute <= 3; attribute++) {
+		glEnableVertexAttribArray(attribute);
+		glVertexAttribDivisor(attribute, 1);
+	}
+
+	BindVertexArray(0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	unsigned char white[4] = { 255, 255, 255, 255 };
+	glGenTextures(1, &whiteTexture);
+	BindTexture2D(whiteTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	queuedItems.reserve(1024);
+	quadVertices.reserve(4096);
+}
+
+void ShutdownBatchRenderer() {
+	DeleteVertexArray(batchVAO);
+	glDeleteBuffers(1, &batchVBO);
+	glDeleteBuffers(1, &batchEBO);
+	DeleteVertexArray(rectVAO);
+	glDeleteBuffers(1, &rectCornerVBO);
+	glDeleteBuffers(1, &rectInstanceVBO);
+	DeleteTexture(whiteTexture);
+	batchVAO = batchVBO = batchEBO = whiteTexture = 0;
+	rectVAO = rectCornerVBO = rectInstanceVBO = 0;
+	vertexCapacity = indexCapacity = instanceCapacity = 0;
+	queuedItems.clear();
+	quadVertices.clear();
+	rectInstances.clear();
+}
+
+unsigned int BatchWhiteTexture() {
+	return whiteTexture;
+}
+
+void BatchQuad(unsigned int program, unsigned int texture, const BatchVertex quad[4]) {
+	BatchItem item;
+	item.program = program;
+	item.texture = texture;
+	item.kind = BATCH_QUAD;
+	item.minX = item.maxX = quad[0].x;
+	item.minY = item.maxY = quad[0].y;
+	for (int i = 1; i < 4; i++) {
+		item.minX = std::min(item.minX, quad[i].x);
+		item.maxX = std::max(item.maxX, quad[i].x);
+		item.minY = std::min(item.minY, quad[i].y);
+		item.maxY = std::max(item.maxY, quad[i].y);
+	}
+	item.depth = 0;
+	item.dataIndex = static_cast<unsigned int>(quadVertices.size());
+	quadVertices.insert(quadVertices.end(), quad, quad + 4);
+	queuedItems.push_back(item);
+}
+
+// Shared by the two rect entry points, so each is traced under its own zone only
+static void QueueRect(unsigned int program, unsigned int texture, float x, float y, float width, float height,
+	glm::vec4 uv, glm::vec4 color) {
+	BatchVertex quad[4] = {
+		{ x,         y,          uv.x, uv.y, color.r, color.g, color.b, color.a },
+		{ x,         y + height, uv.x, uv.w, color.r, color.g, color.b, color.a },
+		{ x + width, y + height, uv.z, uv.w, color.r, color.g, color.b, color.a },
+		{ x + width, y,          uv.z, uv.y, color.r, color.g, color.b, color.a }
+	};
+	BatchQuad(program, texture, quad);
+}
+
+void BatchRect(unsigned int program, float x, float y, float width, float height, glm::vec4 color) {
+	TRACE_ZONE("Rect");
+	QueueRect(program, whiteTexture, x, y, width, height, glm::vec4(0.0f, 0.0f, 1.0f, 1.0f), color);
+}
+
+void BatchTexturedRect(unsigned int program, unsigned int texture, float x, float y, float width, float height,
+	glm::vec4 uv, glm::vec4 color) {
+	TRACE_ZONE("Texture");
+	QueueRect(program, texture, x, y, width, height, uv, color);
+}
+
+void BatchRoundedRect(unsigned int program, float x, float y, float width, float height, float radius, glm::vec4 color) {
+	TRACE_ZONE("RoundedRect");
+	BatchItem item;
+	item.program = program;
+	item.texture = 0;
+	item.kind = BATCH_ROUNDED_RECT;
+	// The shader widens each quad by a pixel for the anti-aliased edge
+	item.minX = x - 1.0f;
+	item.minY = y - 1.0f;
+	item.maxX = x + width + 1.0f;
+	item.maxY = y + height + 1.0f;
+	item.depth = 0;
+	item.dataIndex = static_cast<unsigned int>(rectInstances.size());
+
+	RoundedRectInstance instance = { x, y, width, height, color.r, color.g, color.b, color.a, radius };
+	rectInstances.push_back(instance);
+	queuedItems.push_back(item);
+}
+
+static bool SameKey(const BatchItem& a, const BatchItem& b) {
+	return a.kind == b.kind && a.program == b.program && a.texture == b.texture;
+}
+
+static bool Overlaps(const BatchItem& a, const BatchItem& b) {
+	return a.minX < b.maxX && b.minX < a.maxX && a.minY < b.maxY && b.minY < a.maxY;
+}
+
+// An item has to be drawn after every earlier item it overlaps that uses a
+// different program or texture. Giving it a depth one past the deepest such
+// item means items sharing a depth never overlap across keys, so each depth
+// can be regrouped by key freely.
+static void AssignDepths() {
+	const size_t itemCount = queuedItems.size();
+	float left = queuedItems[0].minX, bottom = queuedItems[0].minY;
+	float right = queuedItems[0].maxX, top = queuedItems[0].maxY;
+	for (const BatchItem& item : queuedItems) {
+		left = std::min(left, item.minX);
+		bottom = std::min(bottom, item.minY);
+		right = std::max(right, item.maxX);
+		top = std::max(top, item.maxY);
+	}
+	const float cellSize = std::max(kGridCellSize, std::max(right - left, top - bottom) / kMaxGridCells);
+	const int columns = std::min(std::max(static_cast<int>(std::ceil((right - left) / cellSize)), 1), kMaxGridCells);
+	const int rows = std::min(std::max(static_cast<int>(std::ceil((top - bottom) / cellSize)), 1), kMaxGridCells);
+	if (gridCells.size() < static_cast<size_t>(columns * rows)) gridCells.resize(columns * rows);
+	for (int cell = 0; cell < columns * rows; cell++) gridCells[cell].clear();
+	lastTested.assign(itemCount, static_cast<unsigned int>(-1));
+
+	for (size_t i = 0; i < itemCount; i++) {
+		BatchItem& item = queuedItems[i];
+		const int firstColumn = std::min(static_cast<int>((item.minX - left) / cellSize), columns - 1);
+		const int lastColumn = std::min(static_cast<int>((item.maxX - left) / cellSize), columns - 1);
+		const int firstRow = std::min(static_cast<int>((item.minY - bottom) / cellSize), rows - 1);
+		const int lastRow = std::min(static_cast<int>((item.maxY - bottom) / cellSize), rows - 1);
+
+		int depth = 0;
+		for (int row = firstRow; row <= lastRow; row++) {
+			for (int column = firstColumn; column <= lastColumn; column++) {
+				std::vector<unsigned int>& cell = gridCells[row * columns + column];
+				for (unsigned int j : cell) {
+					// Items spanning several cells are tested once
+					if (lastTested[j] == i) continue;
+					lastTested[j] = static_cast<unsigned int>(i);
+					const BatchItem& other = queuedItems[j];
+					if (!Overlaps(item, other)) continue;
+					int required = SameKey(item, other) ? other.depth : other.depth + 1;
+					depth = std::max(depth, required);
+				}
+				cell.push_back(static_cast<unsigned int>(i));
+			}
+		}
+		item.depth = depth;
+	}
+}
+
+void FlushBatch() {
+	TRACE_ZONE("FlushBatch");
+	if (queuedItems.empty()) return;
+
+	const size_t itemCount = queuedItems.size();
+	drawOrder.resize(itemCount);
+	for (size_t i = 0; i < itemCount; i++) drawOrder[i] = static_cast<unsigned int>(i);
+
+	AssignDepths();
+	std::stable_sort(drawOrder.begin(), drawOrder.end(), [](unsigned int a, unsigned int b) {
+		const BatchItem& ia = queuedItems[a];
+		const BatchItem& ib = queuedItems[b];
+		if (ia.depth != ib.depth) return ia.depth < ib.depth;
+		if (ia.kind != ib.kind) return ia.kind < ib.kind;
+		if (ia.program != ib.program) return ia.program < ib.program;
+		return ia.texture < ib.texture;
+	});
+
+	// Gather both kinds in draw order so each run is one contiguous range
+	uploadVertices.clear();
+	uploadInstances.clear();
+	for (size_t i = 0; i < itemCount; i++) {
+		const BatchItem& item = queuedItems[drawOrder[i]];
+		if (item.kind == BATCH_QUAD) {
+			const BatchVertex* vertices = &quadVertices[item.dataIndex];
+			uploadVertices.insert(uploadVertices.end(), vertices, vertices + 4);
+		}
+		else {
+			uploadInstances.push_back(rectInstances[item.dataIndex]);
+		}
+	}
+
+	// Orphan the previous storage so the driver never waits on last frame's draws
+	const size_t quadCount = uploadVertices.size() / 4;
+	if (quadCount > 0) {
+		BindVertexArray(batchVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, batchVBO);
+		if (quadCount > vertexCapacity) {
+			vertexCapacity = vertexCapacity ? vertexCapacity : 256;
+			while (vertexCapacity < quadCount) vertexCapacity *= 2;
+		}
+		glBufferData(GL_ARRAY_BUFFER, vertexCapacity * 4 * sizeof(BatchVertex), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, uploadVertices.size() * sizeof(BatchVertex), uploadVertices.data());
+		CountBufferUpload(uploadVertices.size() * sizeof(BatchVertex));
+		EnsureIndexCapacity(quadCount);
+	}
+	if (!uploadInstances.empty()) {
+		glBindBuffer(GL_ARRAY_BUFFER, rectInstanceVBO);
+		if (uploadInstances.size() > instanceCapacity) {
+			instanceCapacity = instanceCapacity ? instanceCapacity : 64;
+			while (instanceCapacity < uploadInstances.size()) instanceCapacity *= 2;
+		}
+		glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(RoundedRectInstance), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, uploadInstances.size() * sizeof(RoundedRectInstance), uploadInstances.data());
+		CountBufferUpload(uploadInstances.size() * sizeof(RoundedRectInstance));
+	}
+
+	EnableBlend(true);
+	SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	ActiveTexture(GL_TEXTURE0);
+	size_t runStart = 0;
+	size_t quadOffset = 0, instanceOffset = 0;
+	while (runStart < itemCount) {
+		const BatchItem& first = queuedItems[drawOrder[runStart]];
+		size_t runEnd = runStart + 1;
+		while (runEnd < itemCount && SameKey(queuedItems[drawOrder[runEnd]], first)) runEnd++;
+		const size_t runLength = runEnd - runStart;
+
+		UseProgram(first.program);
+		if (first.kind == BATCH_QUAD) {
+			BindVertexArray(batchVAO);
+			BindTexture2D(first.texture);
+			glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(runLength * 6), GL_UNSIGNED_INT,
+				(void*)(quadOffset * 6 * sizeof(unsigned int)));
+			CountDrawCall();
+			quadOffset += runLength;
+		}
+		else {
+			BindVertexArray(rectVAO);
+			BindRectInstances(instanceOffset);
+			glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(runLength));
+			CountDrawCall();
+			instanceOffset += runLength;
+		}
+		runStart = runEnd;
+	}
+
+	// The VAO stays bound; the next flush usually starts with the same one
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	queuedItems.clear();
+	quadVertices.clear();
+	rectInstances.clear();
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <glm/glm.hpp>
+
+// Vertex layout shared by every program drawn through the batch:
+// location 0 = vec4(position.xy, texcoord.xy), location 1 = vec4 color
+struct BatchVertex {
+	float x, y, u, v;
+	float r, g, b, a;
+};
+
+// Persistent streaming renderer for 2D quads and rounded rects. Items are
+// collected during the frame and submitted by FlushBatch() with one buffer
+// upload, reordered by program and texture wherever that does not change what
+// ends up on screen.
+void InitBatchRenderer();
+void ShutdownBatchRenderer();
+
+// 1x1 white texture used for solid color quads
+unsigned int BatchWhiteTexture();
+
+// Corners are expected in the order bottom-left, top-left, top-right, bottom-right
+void BatchQuad(unsigned int program, unsigned int texture, const BatchVertex quad[4]);
+void BatchRect(unsigned int program, float x, float y, float width, float height, glm::vec4 color);
+// uv.xy is the texcoord at (x, y), uv.zw the texcoord at (x + width, y + height)
+void BatchTexturedRect(unsigned int program, unsigned int texture, float x, float y, float width, float height,
+	glm::vec4 uv, glm::vec4 color = glm::vec4(1.0f));
+
+// Instanced rounded rect: only the rect's bounding quad is rasterized.
+// `program` reads a unit corner at location 0 and per-instance
+// vec4(x, y, width, height), vec4 color and float radius at locations 1-3.
+void BatchRoundedRect(unsigned int program, float x, float y, float width, float height, float radius, glm::vec4 color);
+
+// Draws everything queued so far. Must be called before any immediate draw
+// that has to appear on top of queued quads, and before swapping buffers.
+void FlushBatch();
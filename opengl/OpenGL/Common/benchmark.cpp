@@ -0,0 +1,350 @@
+#include "benchmark.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+#include "damage.h"
+#include "glstate.h"
+#include "imageatlas.h"
+#include "scene.h"
+#include "softraster.h"
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+// Every allocation in the process goes through these, so a frame's share
+// can be read off two counters. They only count while RunFrameBenchmark
+// runs; otherwise an allocation pays one relaxed load on top of malloc.
+static std::atomic<bool> countAllocations(false);
+static std::atomic<size_t> allocationCount(0);
+static std::atomic<size_t> allocatedBytes(0);
+
+void* operator new(size_t size) {
+	if (countAllocations.load(std::memory_order_relaxed)) {
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	try {
+		return operator new(size);
+	}
+	catch (const std::bad_alloc&) {
+		return NULL;
+	}
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, size_t) noexcept {
+	std::free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept {
+	std::free(memory);
+}
+
+// CPU time of the calling thread. Windows counts it in scheduler ticks, so
+// single frames there read as 0 or a multiple of about 15.6 ms and only
+// the mean over many frames means much.
+static double ThreadCpuMilliseconds() {
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) return 0.0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (k.QuadPart + u.QuadPart) / 10000.0; // 100 ns units
+#else
+	timespec now;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+#endif
+}
+
+bool ParseBenchmarkOptions(int argc, char** argv, BenchmarkOptions& options) {
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--record-golden") == 0) {
+			options.recordGolden = true;
+			continue;
+		}
+		bool benchmark = std::strcmp(argv[i], "--benchmark") == 0;
+		bool report = std::strcmp(argv[i], "--report") == 0;
+		bool golden = std::strcmp(argv[i], "--golden") == 0;
+		bool tolerance = std::strcmp(argv[i], "--tolerance") == 0;
+		if (!benchmark && !report && !golden && !tolerance) continue;
+		if (i + 1 >= argc) {
+			std::cerr << "ERROR::BENCHMARK: " << argv[i] << " needs a value" << std::endl;
+			return false;
+		}
+		const char* value = argv[++i];
+		if (benchmark) options.frames = std::atoi(value);
+		else if (report) options.report = value;
+		else if (golden) options.golden = value;
+		else options.tolerance = std::atoi(value);
+		if ((benchmark && options.frames <= 0) || (tolerance && options.tolerance < 0)) {
+			std::cerr << "ERROR::BENCHMARK: Invalid value for " << argv[i - 1] << ": " << value << std::endl;
+			return false;
+		}
+	}
+	if (options.recordGolden && options.golden.empty()) {
+		std::cerr << "ERROR::BENCHMARK: --record-golden needs --golden <file.png>" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+struct GoldenResult {
+	const char* status; // "none", "recorded", "missing", "matched", "mismatched" or "unreadable"
+	int maxDifference;
+	size_t differingPixels;
+};
+
+// Compares RGB of `rgba` (rows top first) with the golden image, or records
+// it when asked to
+static GoldenResult CheckGolden(const BenchmarkOptions& options, const unsigned char* rgba, int width, int height) {
+	GoldenResult result = { "none", 0, 0 };
+	if (options.golden.empty()) return result;
+
+	const char* path = options.golden.c_str();
+	if (options.recordGolden) {
+		result.status = "recorded";
+		if (!SavePNG(path, rgba, width, height)) {
+			std::cerr << "ERROR::BENCHMARK: Failed to write " << path << std::endl;
+			result.status = "unreadable";
+		}
+		return result;
+	}
+	std::ifstream existing(path, std::ios::binary);
+	if (!existing) {
+		// A golden is only ever written on purpose, so a missing one fails the run
+		std::cerr << "ERROR::BENCHMARK: No golden at " << path << "; run with --record-golden to create it" << std::endl;
+		result.status = "missing";
+		return result;
+	}
+	existing.close();
+
+	int goldenWidth, goldenHeight, channels;
+	stbi_set_flip_vertically_on_load(false);
+	unsigned char* golden = stbi_load(path, &goldenWidth, &goldenHeight, &channels, 4);
+	if (!golden) {
+		result.status = "unreadable";
+		return result;
+	}
+	if (goldenWidth != width || goldenHeight != height) {
+		result.status = "mismatched";
+		result.maxDifference = 255;
+		result.differingPixels = static_cast<size_t>(width) * height;
+	}
+	else {
+		for (size_t i = 0; i < static_cast<size_t>(width) * height; i++) {
+			int difference = 0;
+			for (int c = 0; c < 3; c++) difference = std::max(difference, std::abs(rgba[i * 4 + c] - golden[i * 4 + c]));
+			result.maxDifference = std::max(result.maxDifference, difference);
+			if (difference > options.tolerance) result.differingPixels++;
+		}
+		result.status = result.differingPixels == 0 ? "matched" : "mismatched";
+	}
+	stbi_image_free(golden);
+
+	if (std::strcmp(result.status, "mismatched") == 0) {
+		std::string actual = options.golden;
+		if (actual.size() > 4 && actual.compare(actual.size() - 4, 4, ".png") == 0) actual.resize(actual.size() - 4);
+		SavePNG((actual + ".actual.png").c_str(), rgba, width, height);
+	}
+	return result;
+}
+
+struct Summary {
+	double mean, median, p95, max;
+};
+
+static Summary Summarize(std::vector<double> values) {
+	Summary summary = { 0.0, 0.0, 0.0, 0.0 };
+	if (values.empty()) return summary;
+	std::sort(values.begin(), values.end());
+	for (double value : values) summary.mean += value;
+	summary.mean /= values.size();
+	summary.median = values[values.size() / 2];
+	summary.p95 = values[std::min(values.size() - 1, values.size() * 95 / 100)];
+	summary.max = values.back();
+	return summary;
+}
+
+static void WriteSummary(std::ostream& out, const char* key, const Summary& summary, bool last = false) {
+	out << "    \"" << key << "\": { \"mean\": " << summary.mean << ", \"median\": " << summary.median
+		<< ", \"p95\": " << summary.p95 << ", \"max\": " << summary.max << " }" << (last ? "\n" : ",\n");
+}
+
+// `text` as a quoted JSON string; Windows paths are full of backslashes
+static void WriteJsonString(std::ostream& out, const std::string& text) {
+	out << '"';
+	for (char c : text) {
+		unsigned char byte = static_cast<unsigned char>(c);
+		if (c == '"' || c == '\\') {
+			out << '\\' << c;
+		}
+		else if (byte < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", byte);
+			out << escaped;
+		}
+		else {
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+static void WriteReport(std::ostream& out, const char* name, const BenchmarkOptions& options,
+	const std::vector<FrameSample>& samples, const GoldenResult& golden) {
+	std::vector<double> cpu, wall, draws, allocations;
+	for (const FrameSample& sample : samples) {
+		cpu.push_back(sample.cpuMilliseconds);
+		wall.push_back(sample.wallMilliseconds);
+		draws.push_back(sample.drawCalls);
+		allocations.push_back(static_cast<double>(sample.allocatedBytes));
+	}
+
+	out << std::fixed << std::setprecision(3);
+	out << "{\n";
+	out << "  \"scene\": ";
+	WriteJsonString(out, name);
+	out << ",\n";
+	out << "  \"backend\": \"" << (SoftwareRendering() ? "software" : "gl") << "\",\n";
+	out << "  \"frames\": " << samples.size() << ",\n";
+	out << "  \"summary\": {\n";
+	WriteSummary(out, "cpuMilliseconds", Summarize(cpu));
+	WriteSummary(out, "wallMilliseconds", Summarize(wall));
+	WriteSummary(out, "drawCalls", Summarize(draws));
+	WriteSummary(out, "allocatedBytes", Summarize(allocations), true);
+	out << "  },\n";
+	out << "  \"perFrame\": [\n";
+	for (size_t i = 0; i < samples.size(); i++) {
+		const FrameSample& s = samples[i];
+		out << "    { \"cpuMilliseconds\": " << s.cpuMilliseconds << ", \"wallMilliseconds\": " << s.wallMilliseconds
+			<< ", \"drawCalls\": " << s.drawCalls << ", \"stateChanges\": " << s.stateChanges
+			<< ", \"bufferUploads\": " << s.bufferUploads << ", \"textureUploads\": " << s.textureUploads
+			<< ", \"uploadedBytes\": " << s.uploadedBytes << ", \"allocations\": " << s.allocations
+			<< ", \"allocatedBytes\": " << s.allocatedBytes << " }" << (i + 1 < samples.size() ? ",\n" : "\n");
+	}
+	out << "  ],\n";
+	out << "  \"golden\": { \"path\": ";
+	WriteJsonString(out, options.golden);
+	out << ", \"status\": \"" << golden.status
+		<< "\", \"tolerance\": " << options.tolerance << ", \"maxDifference\": " << golden.maxDifference
+		<< ", \"differingPixels\": " << golden.differingPixels << " }\n";
+	out << "}\n";
+}
+
+bool RunFrameBenchmark(const char* name, Scene& scene, int width, int height, glm::vec3 clearColor,
+	const BenchmarkOptions& options, void (*drawFrame)(), const char* output) {
+	typedef std::chrono::steady_clock Clock;
+	bool software = SoftwareRendering();
+	FinishImageDecodes();
+
+	SoftwareCanvas canvas(software ? width : 1, software ? height : 1);
+	DamageRegion damage(width, height);
+	damage.AddAll();
+	std::vector<FrameSample> samples;
+	samples.reserve(options.frames);
+	EndGLStateFrame();
+	countAllocations.store(true, std::memory_order_relaxed);
+
+	for (int frame = 0; frame < options.frames; frame++) {
+		// Nothing changes between frames, so each one repaints everything
+		scene.Invalidate();
+		size_t allocationsBefore = allocationCount.load(std::memory_order_relaxed);
+		size_t bytesBefore = allocatedBytes.load(std::memory_order_relaxed);
+		double cpuBefore = ThreadCpuMilliseconds();
+		Clock::time_point start = Clock::now();
+
+		if (software) {
+			UpdateImageAtlas();
+			scene.Repaint(damage, clearColor, canvas);
+		}
+		else {
+			drawFrame();
+			glFinish();
+		}
+
+		std::chrono::duration<double, std::milli> wall = Clock::now() - start;
+		GLStateCounters counters = EndGLStateFrame();
+		FrameSample sample;
+		sample.cpuMilliseconds = ThreadCpuMilliseconds() - cpuBefore;
+		sample.wallMilliseconds = wall.count();
+		sample.drawCalls = counters.drawCalls;
+		sample.stateChanges = counters.Issued();
+		sample.bufferUploads = counters.bufferUploads;
+		sample.textureUploads = counters.textureUploads;
+		sample.uploadedBytes = counters.uploadedBytes;
+		sample.allocations = allocationCount.load(std::memory_order_relaxed) - allocationsBefore;
+		sample.allocatedBytes = allocatedBytes.load(std::memory_order_relaxed) - bytesBefore;
+		samples.push_back(sample);
+	}
+	countAllocations.store(false, std::memory_order_relaxed);
+
+	std::vector<unsigned char> pixels;
+	const unsigned char* frame = canvas.Pixels();
+	if (!software) {
+		ReadFramePixels(width, height, pixels);
+		frame = pixels.data();
+	}
+	GoldenResult golden = CheckGolden(options, frame, width, height);
+	if (software && output) canvas.SavePNG(output);
+
+	bool written = true;
+	if (options.report.empty()) {
+		WriteReport(std::cout, name, options, samples, golden);
+	}
+	else {
+		std::ofstream out(options.report.c_str(), std::ios::trunc);
+		if (out) WriteReport(out, name, options, samples, golden);
+		written = static_cast<bool>(out);
+		if (!written) std::cerr << "ERROR::BENCHMARK: Failed to write " << options.report << std::endl;
+	}
+	bool goldenFailed = std::strcmp(golden.status, "mismatched") == 0 || std::strcmp(golden.status, "missing") == 0 ||
+		std::strcmp(golden.status, "unreadable") == 0;
+	return written && !goldenFailed;
+}
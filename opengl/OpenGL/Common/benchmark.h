@@ -0,0 +1,46 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <string>
+
+class Scene;
+
+// Command line of a benchmark run: "--benchmark <frames>", optionally with
+// "--report <file.json>" (standard output otherwise), "--golden <file.png>",
+// "--tolerance <levels>" and "--record-golden". The goldens the apps are
+// checked against live in opengl/goldens, one per app and renderer.
+struct BenchmarkOptions {
+	int frames = 0; // 0 when not benchmarking
+	std::string report;
+	std::string golden;
+	int tolerance = 2; // largest per-channel difference still counted as equal
+	bool recordGolden = false; // write the last frame as the golden instead of comparing; needs golden
+};
+
+// False, after saying why on std::cerr, when an option is malformed
+bool ParseBenchmarkOptions(int argc, char** argv, BenchmarkOptions& options);
+
+// What one frame cost. Draws, state changes and uploads are those issued to
+// GL and stay 0 when rendering in software; allocations count every
+// operator new in the process while the frame was drawn.
+struct FrameSample {
+	double cpuMilliseconds;  // CPU time of the drawing thread
+	double wallMilliseconds; // until GL finished the frame
+	unsigned int drawCalls;
+	unsigned int stateChanges;
+	unsigned int bufferUploads, textureUploads;
+	size_t uploadedBytes;
+	size_t allocations, allocatedBytes;
+};
+
+// Draws `options.frames` frames of `scene`, each a full repaint after every
+// pending image has arrived, and reports one FrameSample per frame as JSON.
+// In software rendering the frames are drawn on a canvas of `width` x
+// `height`, and the last one is saved to `output` when given; otherwise
+// `drawFrame` must draw the scene into the frame copy the way the main loop
+// does. The last frame is then compared with the golden image, or replaces
+// it with --record-golden; on a mismatch the frame is saved next to it as
+// "<golden>.actual.png". Returns false when the frame did not match, the
+// golden is missing or unreadable, or the report could not be written.
+bool RunFrameBenchmark(const char* name, Scene& scene, int width, int height, glm::vec3 clearColor,
+	const BenchmarkOptions& options, void (*drawFrame)(), const char* output = NULL);
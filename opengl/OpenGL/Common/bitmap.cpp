@@ -0,0 +1,184 @@
+#include "bitmap.h"
+#include <algorithm>
+#include <bitset>
+#include <iterator>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+static const size_t kWords = 65536 / 64;
+
+static uint32_t PopCount(uint64_t word) {
+	return static_cast<uint32_t>(std::bitset<64>(word).count());
+}
+
+// Index of the lowest set bit; `word` must not be 0
+static uint32_t LowestBit(uint64_t word) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	unsigned long index;
+	_BitScanForward64(&index, word);
+	return index;
+#elif defined(_MSC_VER)
+	unsigned long index;
+	if (_BitScanForward(&index, static_cast<unsigned long>(word))) return index;
+	_BitScanForward(&index, static_cast<unsigned long>(word >> 32));
+	return index + 32;
+#else
+	return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+}
+
+void RoaringBitmap::ToBits(Container& container) {
+	container.words.assign(kWords, 0);
+	for (uint16_t low : container.values) container.words[low / 64] |= 1ull << (low % 64);
+	std::vector<uint16_t>().swap(container.values);
+}
+
+void RoaringBitmap::ToArray(Container& container) {
+	container.values.clear();
+	container.values.reserve(container.count);
+	for (size_t w = 0; w < container.words.size(); w++) {
+		for (uint64_t bits = container.words[w]; bits; bits &= bits - 1) {
+			container.values.push_back(static_cast<uint16_t>(w * 64 + LowestBit(bits)));
+		}
+	}
+	std::vector<uint64_t>().swap(container.words);
+}
+
+void RoaringBitmap::Add(uint32_t value) {
+	uint16_t key = static_cast<uint16_t>(value >> 16);
+	uint16_t low = static_cast<uint16_t>(value & 0xFFFF);
+
+	// Appending in order only ever looks at the last container
+	if (containers.empty() || containers.back().key < key) {
+		containers.push_back(Container());
+		containers.back().key = key;
+		containers.back().count = 0;
+	}
+	auto it = containers.end() - 1;
+	if (it->key != key) {
+		it = std::lower_bound(containers.begin(), containers.end(), key,
+			[](const Container& container, uint16_t k) { return container.key < k; });
+		if (it->key != key) {
+			it = containers.insert(it, Container());
+			it->key = key;
+			it->count = 0;
+		}
+	}
+
+	Container& container = *it;
+	if (!container.words.empty()) {
+		uint64_t bit = 1ull << (low % 64);
+		if (!(container.words[low / 64] & bit)) {
+			container.words[low / 64] |= bit;
+			container.count++;
+		}
+		return;
+	}
+	if (container.values.empty() || container.values.back() < low) {
+		container.values.push_back(low);
+	}
+	else {
+		auto at = std::lower_bound(container.values.begin(), container.values.end(), low);
+		if (*at == low) return;
+		container.values.insert(at, low);
+	}
+	if (++container.count > kArrayLimit) ToBits(container);
+}
+
+const RoaringBitmap::Container* RoaringBitmap::Find(uint16_t key) const {
+	auto it = std::lower_bound(containers.begin(), containers.end(), key,
+		[](const Container& container, uint16_t k) { return container.key < k; });
+	return it != containers.end() && it->key == key ? &*it : nullptr;
+}
+
+bool RoaringBitmap::Contains(uint32_t value) const {
+	const Container* container = Find(static_cast<uint16_t>(value >> 16));
+	if (!container) return false;
+	uint16_t low = static_cast<uint16_t>(value & 0xFFFF);
+	if (!container->words.empty()) return (container->words[low / 64] >> (low % 64)) & 1;
+	return std::binary_search(container->values.begin(), container->values.end(), low);
+}
+
+size_t RoaringBitmap::Count() const {
+	size_t count = 0;
+	for (const Container& container : containers) count += container.count;
+	return count;
+}
+
+void RoaringBitmap::ToVector(std::vector<uint32_t>& values) const {
+	values.clear();
+	values.reserve(Count());
+	for (const Container& container : containers) {
+		uint32_t high = static_cast<uint32_t>(container.key) << 16;
+		if (container.words.empty()) {
+			for (uint16_t low : container.values) values.push_back(high | low);
+			continue;
+		}
+		for (size_t w = 0; w < kWords; w++) {
+			for (uint64_t bits = container.words[w]; bits; bits &= bits - 1) {
+				values.push_back(high | static_cast<uint32_t>(w * 64 + LowestBit(bits)));
+			}
+		}
+	}
+}
+
+size_t RoaringBitmap::Bytes() const {
+	size_t bytes = containers.capacity() * sizeof(Container);
+	for (const Container& container : containers) {
+		bytes += container.values.capacity() * sizeof(uint16_t) + container.words.capacity() * sizeof(uint64_t);
+	}
+	return bytes;
+}
+
+RoaringBitmap::Container RoaringBitmap::And(const Container& a, const Container& b) {
+	Container result;
+	result.key = a.key;
+	if (!a.words.empty() && !b.words.empty()) {
+		// Dense on both sides: one AND per 64 values
+		result.words.resize(kWords);
+		uint32_t count = 0;
+		for (size_t w = 0; w < kWords; w++) {
+			result.words[w] = a.words[w] & b.words[w];
+			count += PopCount(result.words[w]);
+		}
+		result.count = count;
+		if (count <= kArrayLimit) ToArray(result);
+		return result;
+	}
+	if (a.words.empty() && b.words.empty()) {
+		std::set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+			std::back_inserter(result.values));
+	}
+	else {
+		// Probe the set with the array
+		const Container& sparse = a.words.empty() ? a : b;
+		const Container& dense = a.words.empty() ? b : a;
+		for (uint16_t low : sparse.values) {
+			if ((dense.words[low / 64] >> (low % 64)) & 1) result.values.push_back(low);
+		}
+	}
+	result.count = static_cast<uint32_t>(result.values.size());
+	return result;
+}
+
+RoaringBitmap RoaringBitmap::And(const RoaringBitmap& a, const RoaringBitmap& b) {
+	RoaringBitmap result;
+	auto left = a.containers.begin();
+	auto right = b.containers.begin();
+	while (left != a.containers.end() && right != b.containers.end()) {
+		if (left->key < right->key) {
+			++left;
+		}
+		else if (right->key < left->key) {
+			++right;
+		}
+		else {
+			Container container = And(*left, *right);
+			if (container.count > 0) result.containers.push_back(std::move(container));
+			++left;
+			++right;
+		}
+	}
+	return result;
+}
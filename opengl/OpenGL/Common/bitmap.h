@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressed set of 32-bit values in the style of Roaring bitmaps. Values
+// are grouped by their high 16 bits into containers; a container holds its
+// low 16 bits as a sorted array while it has at most kArrayLimit of them and
+// as a 65536-bit set once denser, so neither a sparse nor a dense set costs
+// more than about two bytes per value. Intersections work container by
+// container and never visit values one at a time when both sides are dense.
+class RoaringBitmap {
+public:
+	static const uint32_t kArrayLimit = 4096;
+
+	// Cheapest in increasing order, as when a column is scanned front to back
+	void Add(uint32_t value);
+	bool Contains(uint32_t value) const;
+	size_t Count() const;
+	bool Empty() const { return containers.empty(); }
+	void Clear() { containers.clear(); }
+	// The values in increasing order, replacing the contents of `values`
+	void ToVector(std::vector<uint32_t>& values) const;
+	size_t Bytes() const;
+
+	static RoaringBitmap And(const RoaringBitmap& a, const RoaringBitmap& b);
+
+private:
+	struct Container {
+		uint16_t key;                 // high 16 bits of every value in it
+		uint32_t count;
+		std::vector<uint16_t> values; // sorted low bits, while count <= kArrayLimit
+		std::vector<uint64_t> words;  // 1024 words of bits, once larger
+	};
+
+	static void ToBits(Container& container);
+	static void ToArray(Container& container);
+	static Container And(const Container& a, const Container& b);
+	const Container* Find(uint16_t key) const;
+
+	std::vector<Container> containers; // by key
+};
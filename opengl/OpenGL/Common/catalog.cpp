@@ -0,0 +1,223 @@
+#include "catalog.h"
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+static const char kMagic[4] = { 'P', 'C', 'A', 'T' };
+static const uint32_t kVersion = 2;
+
+struct CatalogHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t productCount, sellerCount, categoryCount, imageCount;
+	uint64_t productsOffset, sellersOffset, categoriesOffset, imagesOffset;
+	uint64_t stringsOffset, stringBytes;
+	CatalogString currency;
+};
+
+static std::atomic<unsigned int> temporaryCounter(0);
+
+static uint64_t Align8(uint64_t offset) {
+	return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+// Whether `count` records of `recordSize` at `offset` lie inside the file and
+// on the boundary the format promises
+static bool SectionFits(uint64_t offset, uint64_t count, uint64_t recordSize, size_t fileSize) {
+	return offset % 8 == 0 && offset <= fileSize && count * recordSize <= fileSize - offset;
+}
+
+bool ProductCatalog::Open(const char* path) {
+	Close();
+	if (!file.Open(path)) return false;
+	if (!Attach(file.Data(), file.Size())) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool ProductCatalog::Adopt(std::vector<unsigned char> bytes) {
+	Close();
+	memory = std::move(bytes);
+	if (!Attach(memory.data(), memory.size())) {
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void ProductCatalog::Close() {
+	file.Close();
+	memory.clear();
+	products = nullptr;
+	sellers = categories = images = nullptr;
+	strings = nullptr;
+	productCount = sellerCount = categoryCount = imageCount = stringBytes = 0;
+	currency.offset = currency.size = 0;
+}
+
+bool ProductCatalog::Attach(const unsigned char* data, size_t size) {
+	if (!data || size < sizeof(CatalogHeader)) return false;
+	CatalogHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) return false;
+	if (!SectionFits(header.productsOffset, header.productCount, sizeof(CatalogProduct), size) ||
+		!SectionFits(header.sellersOffset, header.sellerCount, sizeof(CatalogString), size) ||
+		!SectionFits(header.categoriesOffset, header.categoryCount, sizeof(CatalogString), size) ||
+		!SectionFits(header.imagesOffset, header.imageCount, sizeof(CatalogString), size) ||
+		!SectionFits(header.stringsOffset, header.stringBytes, 1, size)) {
+		return false;
+	}
+
+	products = reinterpret_cast<const CatalogProduct*>(data + header.productsOffset);
+	sellers = reinterpret_cast<const CatalogString*>(data + header.sellersOffset);
+	categories = reinterpret_cast<const CatalogString*>(data + header.categoriesOffset);
+	images = reinterpret_cast<const CatalogString*>(data + header.imagesOffset);
+	strings = reinterpret_cast<const char*>(data + header.stringsOffset);
+	productCount = header.productCount;
+	sellerCount = header.sellerCount;
+	categoryCount = header.categoryCount;
+	imageCount = header.imageCount;
+	stringBytes = static_cast<size_t>(header.stringBytes);
+	currency = header.currency;
+	return true;
+}
+
+StringRef ProductCatalog::String(CatalogString text) const {
+	// Checked on use rather than at open, which would touch every page
+	if (text.offset > stringBytes || text.size > stringBytes - text.offset) return StringRef();
+	return StringRef(strings + text.offset, text.size);
+}
+
+size_t FormatPrice(uint32_t price, StringRef currency, char* out, size_t size) {
+	int written = currency.Empty()
+		? std::snprintf(out, size, "%u.%02u", price / 100, price % 100)
+		: std::snprintf(out, size, "%u.%02u %.*s", price / 100, price % 100, static_cast<int>(currency.size), currency.data);
+	if (written < 0 || size == 0) return 0;
+	return static_cast<size_t>(written) < size ? static_cast<size_t>(written) : size - 1;
+}
+
+bool ParsePrice(StringRef text, uint32_t& price) {
+	size_t i = 0;
+	while (i < text.size && text.data[i] == ' ') i++;
+	uint64_t value = 0;
+	size_t digits = 0;
+	for (; i < text.size && text.data[i] >= '0' && text.data[i] <= '9'; i++, digits++) {
+		value = value * 10 + (text.data[i] - '0');
+		if (value > UINT32_MAX / 100) return false;
+	}
+	if (digits == 0) return false;
+	value *= 100;
+	if (i < text.size && text.data[i] == '.') {
+		i++;
+		uint64_t scale = 10;
+		for (; i < text.size && text.data[i] >= '0' && text.data[i] <= '9'; i++) {
+			// Fractions of a hundredth would need rounding nobody asked for
+			if (scale == 0) return false;
+			value += (text.data[i] - '0') * scale;
+			scale /= 10;
+		}
+		if (value > UINT32_MAX) return false;
+	}
+	// Anything after a space is the currency
+	if (i < text.size && text.data[i] != ' ') return false;
+	price = static_cast<uint32_t>(value);
+	return true;
+}
+
+CatalogString CatalogBuilder::Pooled(StringRef text) {
+	uint32_t index = pool.Intern(text);
+	if (index == poolOffsets.size()) {
+		poolOffsets.push_back(poolBytes);
+		poolBytes += static_cast<uint32_t>(text.size);
+	}
+	CatalogString pooled = { poolOffsets[index], static_cast<uint32_t>(text.size) };
+	return pooled;
+}
+
+void CatalogBuilder::SetCurrency(StringRef text) {
+	currency = Pooled(text);
+}
+
+// Interns `text` in `table`, pooling it the first time it is seen
+static uint32_t TableIndex(StringTable& table, std::vector<CatalogString>& entries, CatalogString pooled, StringRef text) {
+	uint32_t index = table.Intern(text);
+	if (index == entries.size()) entries.push_back(pooled);
+	return index;
+}
+
+void CatalogBuilder::Add(StringRef name, uint32_t price, StringRef seller, StringRef category, StringRef image) {
+	CatalogProduct product;
+	std::memset(&product, 0, sizeof(product));
+	product.name = Pooled(name);
+	product.price = price;
+	product.seller = TableIndex(sellers, sellerStrings, Pooled(seller), seller);
+	product.category = TableIndex(categories, categoryStrings, Pooled(category), category);
+	product.image = TableIndex(images, imageStrings, Pooled(image), image);
+	products.push_back(product);
+}
+
+template <typename T>
+static void Append(std::vector<unsigned char>& bytes, const T* records, size_t count) {
+	const unsigned char* data = reinterpret_cast<const unsigned char*>(records);
+	bytes.insert(bytes.end(), data, data + count * sizeof(T));
+	bytes.resize(static_cast<size_t>(Align8(bytes.size())), 0);
+}
+
+void CatalogBuilder::Write(std::vector<unsigned char>& bytes) const {
+	CatalogHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.productCount = static_cast<uint32_t>(products.size());
+	header.sellerCount = static_cast<uint32_t>(sellerStrings.size());
+	header.categoryCount = static_cast<uint32_t>(categoryStrings.size());
+	header.imageCount = static_cast<uint32_t>(imageStrings.size());
+	header.productsOffset = Align8(sizeof(CatalogHeader));
+	header.sellersOffset = Align8(header.productsOffset + products.size() * sizeof(CatalogProduct));
+	header.categoriesOffset = Align8(header.sellersOffset + sellerStrings.size() * sizeof(CatalogString));
+	header.imagesOffset = Align8(header.categoriesOffset + categoryStrings.size() * sizeof(CatalogString));
+	header.stringsOffset = Align8(header.imagesOffset + imageStrings.size() * sizeof(CatalogString));
+	header.stringBytes = poolBytes;
+	header.currency = currency;
+
+	bytes.clear();
+	bytes.reserve(static_cast<size_t>(header.stringsOffset + poolBytes));
+	Append(bytes, &header, 1);
+	Append(bytes, products.data(), products.size());
+	Append(bytes, sellerStrings.data(), sellerStrings.size());
+	Append(bytes, categoryStrings.data(), categoryStrings.size());
+	Append(bytes, imageStrings.data(), imageStrings.size());
+	for (size_t i = 0; i < pool.Count(); i++) {
+		StringRef text = pool.Get(static_cast<uint32_t>(i));
+		bytes.insert(bytes.end(), text.data, text.data + text.size);
+	}
+}
+
+bool CatalogBuilder::Save(const char* path) const {
+	std::vector<unsigned char> bytes;
+	Write(bytes);
+
+	std::string target = path;
+	std::string temporary = target + "." + std::to_string(temporaryCounter++) + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		if (!out) {
+			out.close();
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+
+	// rename() will not replace an existing file on Windows
+	std::remove(target.c_str());
+	if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "mappedfile.h"
+#include "stringpool.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary product catalog, used in place from a memory-mapped file. After a
+// fixed header come four tables and one string pool:
+//   products   CatalogProduct[productCount]
+//   sellers    CatalogString[sellerCount]
+//   categories CatalogString[categoryCount]
+//   images     CatalogString[imageCount]   image paths
+//   strings    UTF-8 bytes every CatalogString points into
+// Every section starts on an 8-byte boundary and all integers are little
+// endian. Opening reads only the header, so the load time and memory do not
+// depend on the item count; pages are faulted in as rows scroll into view.
+
+// A string in the pool
+struct CatalogString {
+	uint32_t offset;
+	uint32_t size;
+};
+
+struct CatalogProduct {
+	CatalogString name;
+	uint32_t price;    // fixed point, hundredths of the catalog currency
+	uint32_t seller;   // index into the seller table
+	uint32_t category; // index into the category table
+	uint32_t image;    // index into the image table
+};
+
+class ProductCatalog {
+public:
+	// Maps `path`; false when it is missing, truncated or of another version
+	bool Open(const char* path);
+	// Uses catalog bytes already in memory, e.g. from CatalogBuilder::Write
+	bool Adopt(std::vector<unsigned char> bytes);
+	void Close();
+
+	size_t Count() const { return productCount; }
+	const CatalogProduct& Product(size_t index) const { return products[index]; }
+	StringRef Name(size_t index) const { return String(products[index].name); }
+
+	size_t SellerCount() const { return sellerCount; }
+	size_t CategoryCount() const { return categoryCount; }
+	size_t ImageCount() const { return imageCount; }
+	// Out-of-range ids, which only a damaged file holds, read as empty
+	StringRef SellerName(uint32_t seller) const { return seller < sellerCount ? String(sellers[seller]) : StringRef(); }
+	StringRef CategoryName(uint32_t category) const {
+		return category < categoryCount ? String(categories[category]) : StringRef();
+	}
+	StringRef ImagePath(uint32_t image) const { return image < imageCount ? String(images[image]) : StringRef(); }
+	StringRef Currency() const { return String(currency); }
+
+private:
+	bool Attach(const unsigned char* data, size_t size);
+	StringRef String(CatalogString text) const;
+
+	MappedFile file;
+	std::vector<unsigned char> memory;
+	const CatalogProduct* products = nullptr;
+	const CatalogString* sellers = nullptr;
+	const CatalogString* categories = nullptr;
+	const CatalogString* images = nullptr;
+	const char* strings = nullptr;
+	size_t productCount = 0, sellerCount = 0, categoryCount = 0, imageCount = 0;
+	size_t stringBytes = 0;
+	CatalogString currency = { 0, 0 };
+};
+
+// Writes "129.99 DT" for 12999 and "DT"
+size_t FormatPrice(uint32_t price, StringRef currency, char* out, size_t size);
+// Reads "129.99", "129.9", "129" or "129.99 DT" into hundredths; false on
+// anything else
+bool ParsePrice(StringRef text, uint32_t& price);
+
+// Collects products and lays them out in the catalog format. Sellers,
+// categories and images are numbered in order of first use, and equal
+// strings are stored once.
+class CatalogBuilder {
+public:
+	void SetCurrency(StringRef currency);
+	void Add(StringRef name, uint32_t price, StringRef seller, StringRef category, StringRef image);
+	size_t Count() const { return products.size(); }
+
+	void Write(std::vector<unsigned char>& bytes) const;
+	// Written to a temporary file first, so readers never see half a catalog
+	bool Save(const char* path) const;
+
+private:
+	CatalogString Pooled(StringRef text);
+
+	StringTable pool;
+	std::vector<uint32_t> poolOffsets; // byte offset of each pooled string
+	uint32_t poolBytes = 0;
+	StringTable sellers, categories, images;
+	std::vector<CatalogString> sellerStrings, categoryStrings, imageStrings;
+	std::vector<CatalogProduct> products;
+	CatalogString currency = { 0, 0 };
+};
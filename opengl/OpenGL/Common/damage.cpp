@@ -0,0 +1,168 @@
+#include "damage.h"
+#include "glstate.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Every rect costs a scissor change and a batch flush; past this many the
+// closest pair is joined
+static const size_t kMaxRects = 8;
+// Two rects are joined when their union repaints at most this many pixels
+// more than the two of them would separately
+static const long long kMergeSlack = 64 * 64;
+
+static long long RectArea(const DamageRect& r) {
+	return static_cast<long long>(r.width) * r.height;
+}
+
+static DamageRect Union(const DamageRect& a, const DamageRect& b) {
+	int left = std::min(a.x, b.x);
+	int bottom = std::min(a.y, b.y);
+	int right = std::max(a.x + a.width, b.x + b.width);
+	int top = std::max(a.y + a.height, b.y + b.height);
+	DamageRect r = { left, bottom, right - left, top - bottom };
+	return r;
+}
+
+static long long MergeCost(const DamageRect& a, const DamageRect& b) {
+	return RectArea(Union(a, b)) - RectArea(a) - RectArea(b);
+}
+
+DamageRegion::DamageRegion(int screenWidth, int screenHeight)
+	: screenWidth(screenWidth), screenHeight(screenHeight) {
+}
+
+void DamageRegion::Add(glm::vec4 bounds) {
+	if (bounds.z <= 0.0f || bounds.w <= 0.0f) return;
+	int left = std::max(static_cast<int>(std::floor(bounds.x)) - 1, 0);
+	int bottom = std::max(static_cast<int>(std::floor(bounds.y)) - 1, 0);
+	int right = std::min(static_cast<int>(std::ceil(bounds.x + bounds.z)) + 1, screenWidth);
+	int top = std::min(static_cast<int>(std::ceil(bounds.y + bounds.w)) + 1, screenHeight);
+	if (right <= left || top <= bottom) return;
+	DamageRect r = { left, bottom, right - left, top - bottom };
+	rects.push_back(r);
+}
+
+void DamageRegion::AddAll() {
+	rects.clear();
+	DamageRect r = { 0, 0, screenWidth, screenHeight };
+	rects.push_back(r);
+}
+
+void DamageRegion::Merge() {
+	// Join every pair that is cheap to join until nothing changes
+	bool merged = true;
+	while (merged) {
+		merged = false;
+		for (size_t i = 0; i < rects.size() && !merged; i++) {
+			for (size_t j = i + 1; j < rects.size(); j++) {
+				if (MergeCost(rects[i], rects[j]) <= kMergeSlack) {
+					rects[i] = Union(rects[i], rects[j]);
+					rects.erase(rects.begin() + j);
+					merged = true;
+					break;
+				}
+			}
+		}
+	}
+
+	while (rects.size() > kMaxRects) {
+		size_t bestI = 0, bestJ = 1;
+		long long bestCost = MergeCost(rects[0], rects[1]);
+		for (size_t i = 0; i < rects.size(); i++) {
+			for (size_t j = i + 1; j < rects.size(); j++) {
+				long long cost = MergeCost(rects[i], rects[j]);
+				if (cost < bestCost) {
+					bestCost = cost;
+					bestI = i;
+					bestJ = j;
+				}
+			}
+		}
+		rects[bestI] = Union(rects[bestI], rects[bestJ]);
+		rects.erase(rects.begin() + bestJ);
+	}
+
+	// Rect by rect is no longer worth it
+	if (static_cast<long long>(Area()) * 4 > static_cast<long long>(screenWidth) * screenHeight * 3) AddAll();
+}
+
+int DamageRegion::Area() const {
+	long long area = 0;
+	for (const DamageRect& r : rects) area += RectArea(r);
+	return static_cast<int>(area);
+}
+
+bool Overlaps(const DamageRect& rect, glm::vec4 bounds) {
+	// Grown by the same pixel as in Add, for edges that spill past the box
+	return bounds.z > 0.0f && bounds.w > 0.0f &&
+		bounds.x - 1.0f < rect.x + rect.width && bounds.x + bounds.z + 1.0f > rect.x &&
+		bounds.y - 1.0f < rect.y + rect.height && bounds.y + bounds.w + 1.0f > rect.y;
+}
+
+static unsigned int copyFramebuffer = 0;
+static unsigned int copyTexture = 0;
+static int copyWidth = 0, copyHeight = 0;
+
+bool InitFrameCopy(int width, int height) {
+	copyWidth = width;
+	copyHeight = height;
+
+	glGenTextures(1, &copyTexture);
+	BindTexture2D(copyTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+	glGenFramebuffers(1, &copyFramebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, copyFramebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, copyTexture, 0);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete) {
+		std::cerr << "ERROR::DAMAGE: Frame copy framebuffer is incomplete" << std::endl;
+		DeleteFrameCopy();
+	}
+	return complete;
+}
+
+void DeleteFrameCopy() {
+	if (copyFramebuffer != 0) glDeleteFramebuffers(1, &copyFramebuffer);
+	DeleteTexture(copyTexture);
+	copyFramebuffer = 0;
+	copyTexture = 0;
+}
+
+void BindFrameCopy() {
+	glBindFramebuffer(GL_FRAMEBUFFER, copyFramebuffer);
+}
+
+void PresentFrameCopy() {
+	if (copyFramebuffer == 0) return;
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFramebuffer);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+	glBlitFramebuffer(0, 0, copyWidth, copyHeight, 0, 0, copyWidth, copyHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ReadFramePixels(int width, int height, std::vector<unsigned char>& rgba) {
+	rgba.resize(static_cast<size_t>(width) * height * 4);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, copyFramebuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+	// GL returns the bottom row first
+	size_t stride = static_cast<size_t>(width) * 4;
+	std::vector<unsigned char> row(stride);
+	for (int y = 0; y < height / 2; y++) {
+		unsigned char* top = &rgba[y * stride];
+		unsigned char* bottom = &rgba[(height - 1 - y) * stride];
+		std::memcpy(row.data(), top, stride);
+		std::memcpy(top, bottom, stride);
+		std::memcpy(bottom, row.data(), stride);
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+// Pixel rectangle with a bottom-left origin, ready for glScissor
+struct DamageRect {
+	int x, y, width, height;
+};
+
+// The parts of the screen that changed since the last frame
+class DamageRegion {
+public:
+	DamageRegion(int screenWidth, int screenHeight);
+
+	// `bounds` is (x, y, width, height) in screen units. It is rounded out to
+	// whole pixels and grown by one to cover anti-aliased and filtered edges.
+	void Add(glm::vec4 bounds);
+	void AddAll();
+	void Clear() { rects.clear(); }
+
+	// Joins rects that overlap or sit close enough that one scissor is
+	// cheaper than two, caps the count, and falls back to the whole screen
+	// once most of it is damaged anyway
+	void Merge();
+
+	const std::vector<DamageRect>& Rects() const { return rects; }
+	bool Empty() const { return rects.empty(); }
+	int Area() const;
+
+private:
+	int screenWidth, screenHeight;
+	std::vector<DamageRect> rects;
+};
+
+// Whether a node with `bounds`, grown like Add grows them, touches `rect`
+bool Overlaps(const DamageRect& rect, glm::vec4 bounds);
+
+// Offscreen copy of the last frame. The back buffer is undefined after a swap
+// and GLFW does not expose buffer age, so frames are painted into this
+// framebuffer, which keeps every undamaged pixel, and blitted to the window.
+bool InitFrameCopy(int width, int height);
+void DeleteFrameCopy();
+// Makes the copy the draw target
+void BindFrameCopy();
+// Copies the whole frame to the default framebuffer and rebinds it
+void PresentFrameCopy();
+// The last frame as RGBA rows, top first: from the copy, or from the
+// default framebuffer when there is none
+void ReadFramePixels(int width, int height, std::vector<unsigned char>& rgba);
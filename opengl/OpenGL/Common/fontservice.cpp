@@ -0,0 +1,165 @@
+#include "fontservice.h"
+#include "mappedfile.h"
+#include FT_CACHE_H
+#include FT_GLYPH_H
+#include <iostream>
+#include <string>
+
+static const char* const kStyleFiles[FONT_STYLE_COUNT] = {
+	"IBMPlexMono-Thin.ttf",
+	"IBMPlexMono-ThinItalic.ttf",
+	"IBMPlexMono-ExtraLight.ttf",
+	"IBMPlexMono-ExtraLightItalic.ttf",
+	"IBMPlexMono-Light.ttf",
+	"IBMPlexMono-LightItalic.ttf",
+	"IBMPlexMono-Regular.ttf",
+	"IBMPlexMono-Italic.ttf",
+	"IBMPlexMono-Medium.ttf",
+	"IBMPlexMono-MediumItalic.ttf",
+	"IBMPlexMono-SemiBold.ttf",
+	"IBMPlexMono-SemiBoldItalic.ttf",
+	"IBMPlexMono-Bold.ttf",
+	"IBMPlexMono-BoldItalic.ttf"
+};
+
+// What an FTC_FaceID points at. The mapping outlives every FT_Face built on
+// it, so the manager can drop and rebuild faces without touching the disk.
+struct FontFile {
+	std::string path;
+	MappedFile file;
+	bool failed = false;
+};
+
+static FT_Library library = NULL;
+static FTC_Manager manager = NULL;
+static FTC_CMapCache cmapCache = NULL;
+static FTC_SBitCache sbitCache = NULL;
+static FTC_ImageCache imageCache = NULL;
+static FontFile fontFiles[FONT_STYLE_COUNT];
+static FT_Glyph renderedGlyph = NULL; // last bitmap rendered from an image, owned here
+
+static FT_Error RequestFace(FTC_FaceID faceId, FT_Library lib, FT_Pointer, FT_Face* face) {
+	FontFile& font = *static_cast<FontFile*>(faceId);
+	if (!font.file.Data()) {
+		if (font.failed || !font.file.Open(font.path.c_str())) {
+			if (!font.failed) std::cerr << "ERROR::FREETYPE: Failed to load font " << font.path << std::endl;
+			font.failed = true;
+			return FT_Err_Cannot_Open_Resource;
+		}
+	}
+	return FT_New_Memory_Face(lib, font.file.Data(), static_cast<FT_Long>(font.file.Size()), 0, face);
+}
+
+bool InitFontService(const char* directory) {
+	if (FT_Init_FreeType(&library)) {
+		std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+		return false;
+	}
+	if (FTC_Manager_New(library, FONT_MAX_FACES, FONT_MAX_SIZES, FONT_MAX_CACHE_BYTES, RequestFace, NULL, &manager) ||
+		FTC_CMapCache_New(manager, &cmapCache) ||
+		FTC_SBitCache_New(manager, &sbitCache) ||
+		FTC_ImageCache_New(manager, &imageCache)) {
+		std::cerr << "ERROR::FREETYPE: Could not create the glyph caches" << std::endl;
+		ShutdownFontService();
+		return false;
+	}
+	for (int style = 0; style < FONT_STYLE_COUNT; style++) {
+		fontFiles[style].path = std::string(directory) + "/" + kStyleFiles[style];
+		fontFiles[style].failed = false;
+	}
+	return true;
+}
+
+void ShutdownFontService() {
+	if (renderedGlyph) FT_Done_Glyph(renderedGlyph);
+	renderedGlyph = NULL;
+	// Destroys the caches and every face they built
+	if (manager) FTC_Manager_Done(manager);
+	manager = NULL;
+	cmapCache = NULL;
+	sbitCache = NULL;
+	imageCache = NULL;
+	for (FontFile& font : fontFiles) font.file.Close();
+	if (library) FT_Done_FreeType(library);
+	library = NULL;
+}
+
+FT_Library FontLibrary() {
+	return library;
+}
+
+static FTC_FaceID FaceId(FontStyle style) {
+	return static_cast<FTC_FaceID>(&fontFiles[style]);
+}
+
+bool GetFontMetrics(FontStyle style, int pixelSize, FT_Size_Metrics& metrics) {
+	if (!manager || style < 0 || style >= FONT_STYLE_COUNT) return false;
+	FTC_ScalerRec scaler = { FaceId(style), 0, static_cast<FT_UInt>(pixelSize), 1, 0, 0 };
+	FT_Size size;
+	if (FTC_Manager_LookupSize(manager, &scaler, &size)) return false;
+	metrics = size->metrics;
+	return true;
+}
+
+// Renders a copy of a cached glyph image; the cache keeps the original
+static bool RenderImage(FT_Glyph image, FT_Render_Mode mode, FontGlyph& glyph) {
+	glyph.advance = image->advance.x >> 10; // 16.16 to 26.6
+	glyph.width = glyph.rows = glyph.pitch = glyph.left = glyph.top = 0;
+	glyph.pixels = NULL;
+	// Blank glyphs such as the space have nothing to render but still advance
+	if (image->format == FT_GLYPH_FORMAT_OUTLINE && reinterpret_cast<FT_OutlineGlyph>(image)->outline.n_points == 0) return true;
+
+	FT_Glyph rendered = image;
+	if (image->format != FT_GLYPH_FORMAT_BITMAP) {
+		if (FT_Glyph_To_Bitmap(&rendered, mode, NULL, 0)) return false;
+		if (renderedGlyph) FT_Done_Glyph(renderedGlyph);
+		renderedGlyph = rendered;
+	}
+	FT_BitmapGlyph bitmap = reinterpret_cast<FT_BitmapGlyph>(rendered);
+	glyph.width = static_cast<int>(bitmap->bitmap.width);
+	glyph.rows = static_cast<int>(bitmap->bitmap.rows);
+	glyph.pitch = bitmap->bitmap.pitch;
+	glyph.left = bitmap->left;
+	glyph.top = bitmap->top;
+	glyph.pixels = bitmap->bitmap.buffer;
+	return true;
+}
+
+bool RenderFontGlyph(FontStyle style, int pixelSize, uint32_t codepoint, FT_Render_Mode mode, FontGlyph& glyph) {
+	if (!manager || style < 0 || style >= FONT_STYLE_COUNT) return false;
+	FTC_FaceID faceId = FaceId(style);
+	// -1 picks the face's own charmap, Unicode for these fonts
+	FT_UInt index = FTC_CMapCache_Lookup(cmapCache, faceId, -1, codepoint);
+	if (fontFiles[style].failed) return false;
+
+	FTC_ImageTypeRec type;
+	type.face_id = faceId;
+	type.width = 0;
+	type.height = static_cast<FT_UInt>(pixelSize);
+
+	if (mode == FT_RENDER_MODE_NORMAL) {
+		type.flags = FT_LOAD_DEFAULT;
+		FTC_SBit sbit;
+		if (FTC_SBitCache_Lookup(sbitCache, &type, index, &sbit, NULL)) return false;
+		// Glyphs too large for a small bitmap come back without a buffer
+		if (sbit->buffer || sbit->width == 0) {
+			glyph.width = sbit->width;
+			glyph.rows = sbit->height;
+			glyph.pitch = sbit->pitch;
+			glyph.left = sbit->left;
+			glyph.top = sbit->top;
+			glyph.advance = static_cast<long>(sbit->xadvance) * 64;
+			glyph.pixels = sbit->buffer;
+			return true;
+		}
+	}
+	else {
+		// Hinting snaps outlines to this size's pixel grid, which would show
+		// once a distance field is scaled
+		type.flags = FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP;
+	}
+
+	FT_Glyph image;
+	if (FTC_ImageCache_Lookup(imageCache, &type, index, &image, NULL)) return false;
+	return RenderImage(image, mode, glyph);
+}
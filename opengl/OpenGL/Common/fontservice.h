@@ -0,0 +1,55 @@
+#pragma once
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <cstdint>
+
+// The IBM Plex Mono family, one file per style
+enum FontStyle {
+	FONT_THIN,
+	FONT_THIN_ITALIC,
+	FONT_EXTRA_LIGHT,
+	FONT_EXTRA_LIGHT_ITALIC,
+	FONT_LIGHT,
+	FONT_LIGHT_ITALIC,
+	FONT_REGULAR,
+	FONT_ITALIC,
+	FONT_MEDIUM,
+	FONT_MEDIUM_ITALIC,
+	FONT_SEMI_BOLD,
+	FONT_SEMI_BOLD_ITALIC,
+	FONT_BOLD,
+	FONT_BOLD_ITALIC,
+	FONT_STYLE_COUNT
+};
+
+// Limits of FreeType's cache manager: live FT_Face and FT_Size objects, and
+// bytes of cached glyph images and small bitmaps. Faces are rebuilt from
+// memory-mapped files, so going over the face limit never reopens a file.
+const int FONT_MAX_FACES = 4;
+const int FONT_MAX_SIZES = 8;
+const unsigned long FONT_MAX_CACHE_BYTES = 512 * 1024;
+
+// One FT_Library and FTC manager for the whole run. Font files are looked up
+// in `directory` and mapped the first time their style is used.
+bool InitFontService(const char* directory);
+void ShutdownFontService();
+// For module properties such as the SDF spread
+FT_Library FontLibrary();
+
+// Pixel-size metrics of a style, in 26.6 like FT_Size_Metrics
+bool GetFontMetrics(FontStyle style, int pixelSize, FT_Size_Metrics& metrics);
+
+// A rendered glyph. `pixels` is 8-bit, rows top first, NULL for blank
+// glyphs; it belongs to the service and is only valid until the next
+// RenderFontGlyph() call.
+struct FontGlyph {
+	int width, rows, pitch;
+	int left, top;  // bitmap offset from the pen position, y up
+	long advance;   // 26.6
+	const unsigned char* pixels;
+};
+
+// FT_RENDER_MODE_NORMAL comes hinted from the small-bitmap cache;
+// FT_RENDER_MODE_SDF is rendered from the cached unhinted outline.
+// A codepoint the font lacks renders as its .notdef glyph.
+bool RenderFontGlyph(FontStyle style, int pixelSize, uint32_t codepoint, FT_Render_Mode mode, FontGlyph& glyph);
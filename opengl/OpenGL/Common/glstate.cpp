@@ -0,0 +1,223 @@
+#include "glstate.h"
+#include <glad/glad.h>
+#include <cstring>
+#include <iostream>
+
+static const unsigned int kUnknown = 0xFFFFFFFFu;
+static const unsigned int kTextureUnits = 8;
+
+static unsigned int currentProgram = kUnknown;
+static unsigned int currentUnit = kUnknown;
+static unsigned int currentTextures[kTextureUnits];
+static unsigned int currentVertexArray = kUnknown;
+static unsigned int blendEnabled = kUnknown;
+static unsigned int blendSource = kUnknown, blendDestination = kUnknown;
+static unsigned int scissorEnabled = kUnknown;
+static int scissorBox[4];
+static bool scissorBoxKnown = false;
+static float clearColor[4];
+static bool clearColorKnown = false;
+
+static GLStateCounters counters;
+
+void ResetGLStateCache() {
+	currentProgram = kUnknown;
+	currentUnit = kUnknown;
+	for (unsigned int i = 0; i < kTextureUnits; i++) currentTextures[i] = kUnknown;
+	currentVertexArray = kUnknown;
+	blendEnabled = kUnknown;
+	blendSource = blendDestination = kUnknown;
+	scissorEnabled = kUnknown;
+	scissorBoxKnown = false;
+	clearColorKnown = false;
+}
+
+void UseProgram(unsigned int program) {
+	if (program == currentProgram) {
+		counters.programSkipped++;
+		return;
+	}
+	glUseProgram(program);
+	currentProgram = program;
+	counters.programBinds++;
+}
+
+void ActiveTexture(unsigned int unit) {
+	if (unit == currentUnit) {
+		counters.stateSkipped++;
+		return;
+	}
+	glActiveTexture(unit);
+	currentUnit = unit;
+	counters.stateChanges++;
+}
+
+void BindTexture2D(unsigned int texture) {
+	// Units past the tracked range, or an unknown unit, always go through
+	unsigned int slot = currentUnit - GL_TEXTURE0;
+	if (currentUnit != kUnknown && slot < kTextureUnits && texture == currentTextures[slot]) {
+		counters.textureSkipped++;
+		return;
+	}
+	glBindTexture(GL_TEXTURE_2D, texture);
+	if (currentUnit == kUnknown) {
+		// Could have landed on any unit
+		for (unsigned int i = 0; i < kTextureUnits; i++) currentTextures[i] = kUnknown;
+	}
+	else if (slot < kTextureUnits) {
+		currentTextures[slot] = texture;
+	}
+	counters.textureBinds++;
+}
+
+void BindVertexArray(unsigned int vertexArray) {
+	if (vertexArray == currentVertexArray) {
+		counters.vertexArraySkipped++;
+		return;
+	}
+	glBindVertexArray(vertexArray);
+	currentVertexArray = vertexArray;
+	counters.vertexArrayBinds++;
+}
+
+void EnableBlend(bool enabled) {
+	unsigned int value = enabled ? 1u : 0u;
+	if (value == blendEnabled) {
+		counters.stateSkipped++;
+		return;
+	}
+	if (enabled) glEnable(GL_BLEND);
+	else glDisable(GL_BLEND);
+	blendEnabled = value;
+	counters.stateChanges++;
+}
+
+void SetBlendFunc(unsigned int sourceFactor, unsigned int destinationFactor) {
+	if (sourceFactor == blendSource && destinationFactor == blendDestination) {
+		counters.stateSkipped++;
+		return;
+	}
+	glBlendFunc(sourceFactor, destinationFactor);
+	blendSource = sourceFactor;
+	blendDestination = destinationFactor;
+	counters.stateChanges++;
+}
+
+void EnableScissorTest(bool enabled) {
+	unsigned int value = enabled ? 1u : 0u;
+	if (value == scissorEnabled) {
+		counters.stateSkipped++;
+		return;
+	}
+	if (enabled) glEnable(GL_SCISSOR_TEST);
+	else glDisable(GL_SCISSOR_TEST);
+	scissorEnabled = value;
+	counters.stateChanges++;
+}
+
+void SetScissor(int x, int y, int width, int height) {
+	int box[4] = { x, y, width, height };
+	if (scissorBoxKnown && std::memcmp(box, scissorBox, sizeof(box)) == 0) {
+		counters.stateSkipped++;
+		return;
+	}
+	glScissor(x, y, width, height);
+	std::memcpy(scissorBox, box, sizeof(box));
+	scissorBoxKnown = true;
+	counters.stateChanges++;
+}
+
+void SetClearColor(float red, float green, float blue, float alpha) {
+	if (clearColorKnown && clearColor[0] == red && clearColor[1] == green && clearColor[2] == blue && clearColor[3] == alpha) {
+		counters.stateSkipped++;
+		return;
+	}
+	glClearColor(red, green, blue, alpha);
+	clearColor[0] = red;
+	clearColor[1] = green;
+	clearColor[2] = blue;
+	clearColor[3] = alpha;
+	clearColorKnown = true;
+	counters.stateChanges++;
+}
+
+void DeleteProgram(unsigned int program) {
+	if (program == 0) return;
+	glDeleteProgram(program);
+	if (program == currentProgram) currentProgram = kUnknown;
+}
+
+void DeleteTexture(unsigned int texture) {
+	if (texture == 0) return;
+	glDeleteTextures(1, &texture);
+	// GL rebinds 0 on every unit that had it bound
+	for (unsigned int i = 0; i < kTextureUnits; i++) {
+		if (currentTextures[i] == texture) currentTextures[i] = 0;
+	}
+}
+
+void DeleteVertexArray(unsigned int vertexArray) {
+	if (vertexArray == 0) return;
+	glDeleteVertexArrays(1, &vertexArray);
+	if (vertexArray == currentVertexArray) currentVertexArray = 0;
+}
+
+void CountDrawCall() {
+	counters.drawCalls++;
+}
+
+void CountBufferUpload(size_t bytes) {
+	counters.bufferUploads++;
+	counters.uploadedBytes += bytes;
+}
+
+void CountTextureUpload(size_t bytes) {
+	counters.textureUploads++;
+	counters.uploadedBytes += bytes;
+}
+
+GLStateCounters EndGLStateFrame() {
+	GLStateCounters frame = counters;
+	std::memset(&counters, 0, sizeof(counters));
+	return frame;
+}
+
+void PrintGLStateCounters(const GLStateCounters& frame) {
+	std::cout << "GL state: " << frame.Skipped() << " redundant calls skipped"
+		<< " (program " << frame.programSkipped << "/" << frame.programSkipped + frame.programBinds
+		<< ", texture " << frame.textureSkipped << "/" << frame.textureSkipped + frame.textureBinds
+		<< ", VAO " << frame.vertexArraySkipped << "/" << frame.vertexArraySkipped + frame.vertexArrayBinds
+		<< ", other " << frame.stateSkipped << "/" << frame.stateSkipped + frame.stateChanges << ")" << std::endl;
+}
+
+#ifdef _DEBUG
+static const char* DebugTypeName(GLenum type) {
+	switch (type) {
+	case GL_DEBUG_TYPE_ERROR: return "error";
+	case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+	case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behavior";
+	case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+	case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+	default: return "other";
+	}
+}
+
+static void APIENTRY DebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity,
+	GLsizei length, const GLchar* message, const void* userParam) {
+	std::cerr << "OpenGL " << DebugTypeName(type) << " (" << id << "): " << message << std::endl;
+}
+#endif
+
+void InstallGLDebugOutput() {
+#ifdef _DEBUG
+	// KHR_debug is core from 4.3; glad leaves the pointer null when neither is present
+	if (!glDebugMessageCallback) {
+		std::cerr << "KHR_debug is not available; GL errors will not be reported" << std::endl;
+		return;
+	}
+	glEnable(GL_DEBUG_OUTPUT);
+	glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+	glDebugMessageCallback(DebugMessage, NULL);
+	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, NULL, GL_FALSE);
+#endif
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+
+// Thin tracker over the bits of GL state the renderers keep switching.
+// Each setter skips the GL call when the value is already current and
+// counts both outcomes, so a frame's savings can be read back. The draws
+// and uploads issued in between are tallied alongside.
+struct GLStateCounters {
+	unsigned int programBinds, programSkipped;
+	unsigned int textureBinds, textureSkipped;
+	unsigned int vertexArrayBinds, vertexArraySkipped;
+	unsigned int stateChanges, stateSkipped; // active unit, blend, scissor and clear color
+	unsigned int drawCalls;
+	unsigned int bufferUploads, textureUploads;
+	size_t uploadedBytes; // by both kinds of upload
+
+	// Binds and other state changes that reached GL
+	unsigned int Issued() const {
+		return programBinds + textureBinds + vertexArrayBinds + stateChanges;
+	}
+
+	unsigned int Skipped() const {
+		return programSkipped + textureSkipped + vertexArraySkipped + stateSkipped;
+	}
+};
+
+// Forgets everything cached, so the next call of each kind reaches GL.
+// Call after creating the context or after code that bypasses the tracker.
+void ResetGLStateCache();
+
+void UseProgram(unsigned int program);
+void ActiveTexture(unsigned int unit); // GL_TEXTURE0 + n
+void BindTexture2D(unsigned int texture);
+void BindVertexArray(unsigned int vertexArray);
+void EnableBlend(bool enabled);
+void SetBlendFunc(unsigned int sourceFactor, unsigned int destinationFactor);
+void EnableScissorTest(bool enabled);
+void SetScissor(int x, int y, int width, int height);
+void SetClearColor(float red, float green, float blue, float alpha);
+
+// Deleting through these keeps a recycled name from looking already bound
+void DeleteProgram(unsigned int program);
+void DeleteTexture(unsigned int texture);
+void DeleteVertexArray(unsigned int vertexArray);
+
+// Called next to the GL call they stand for
+void CountDrawCall();
+void CountBufferUpload(size_t bytes);
+void CountTextureUpload(size_t bytes);
+
+// Returns the counters of the frame that just ended and starts a new one
+GLStateCounters EndGLStateFrame();
+// One line on std::cout: calls skipped versus issued, by kind
+void PrintGLStateCounters(const GLStateCounters& frame);
+
+// Debug builds only: routes GL errors and warnings through a KHR_debug
+// callback instead of polling glGetError. A no-op in release builds.
+void InstallGLDebugOutput();
@@ -0,0 +1,559 @@
+#include "imageatlas.h"
+#include "glstate.h"
+#include "resample.h"
+#include "softraster.h"
+#include "texturecache.h"
+#include "trace.h"
+#include "workerpool.h"
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Smallest power-of-two cell that holds a width x height image
+static int CellSizeFor(int width, int height) {
+	int size = IMAGE_MIN_CELL_SIZE;
+	while (size < IMAGE_CELL_SIZE && (size < width || size < height)) size *= 2;
+	return size;
+}
+
+// Levels from a full cell down to one texel; past that, levels would blend
+// neighbouring images
+static int CellLevels(int cellSize) {
+	int levels = 1;
+	while ((cellSize >> (levels - 1)) > 1) levels++;
+	return levels;
+}
+
+static int CellsPerRow(int cellSize) {
+	return IMAGE_PAGE_SIZE / cellSize;
+}
+
+struct AtlasPage {
+	unsigned int texture;
+	int cellSize;
+	std::vector<ImageHandle> cells; // owner of each cell, 0 when free
+	std::vector<unsigned char> pixels; // level 0 in place of the texture when rendering in software
+};
+
+enum AtlasEntryState {
+	ENTRY_PENDING, // queued for decoding, drawn as the placeholder
+	ENTRY_READY,
+	ENTRY_FAILED,  // could not be decoded, drawn as the placeholder
+	ENTRY_GONE     // evicted or released
+};
+
+struct AtlasEntry {
+	AtlasEntryState state;
+	int page, cell;
+	int width, height;
+	unsigned int lastUsed;
+	unsigned int generation; // bumped whenever the slot is freed
+	int lruPrev, lruNext;    // neighbours in the LRU list of its cell size, -1 at the ends
+};
+
+// Handles carry the slot index plus one in the low bits and the slot's
+// generation above it, so a handle kept past a release or an eviction stops
+// resolving once the slot is reused. Generations wrap at 2048 reuses.
+static const int kEntryIndexBits = 20;
+static const int kEntryIndexMask = (1 << kEntryIndexBits) - 1;
+static const unsigned int kGenerationMask = 0x7FF;
+
+// Ready images of one cell size, least recently drawn first
+struct LruList {
+	int head, tail;
+};
+static const int kCellSizeClasses = 4; // IMAGE_MIN_CELL_SIZE up to IMAGE_CELL_SIZE
+
+// A finished decode, already resampled to its displayed size and mipmapped by
+// the worker, or the same read back from the texture cache
+struct DecodedCell {
+	ImageHandle image;
+	std::vector<unsigned char> pixels; // every level, largest first
+	CachedTexture cached;
+	int width, height;
+	int cellSize;
+
+	const unsigned char* Levels() const {
+		if (cached.file) return cached.pixels;
+		return pixels.empty() ? NULL : pixels.data();
+	}
+};
+
+static std::vector<AtlasPage> pages;
+static std::vector<AtlasEntry> entries;
+static std::vector<int> freeEntries; // slots of released and evicted images
+static LruList lruLists[kCellSizeClasses] = { { -1, -1 }, { -1, -1 }, { -1, -1 }, { -1, -1 } };
+static int maxPageCount = 0;
+static unsigned int frameCounter = 1;
+static ImageHandle placeholderImage = 0;
+
+static WorkerPool* decodePool = NULL;
+static std::mutex decodedMutex;
+static std::vector<DecodedCell> decodedCells; // guarded by decodedMutex
+static void (*decodedCallback)() = NULL;
+
+static int EntryIndex(ImageHandle image) {
+	return (image & kEntryIndexMask) - 1;
+}
+
+static ImageHandle EntryHandle(int index) {
+	return static_cast<ImageHandle>((entries[index].generation << kEntryIndexBits) | static_cast<unsigned int>(index + 1));
+}
+
+// Entry of a live handle; NULL for 0 and for handles whose slot was freed
+static AtlasEntry* FindEntry(ImageHandle image) {
+	if (image <= 0) return NULL;
+	int index = EntryIndex(image);
+	if (index < 0 || index >= static_cast<int>(entries.size())) return NULL;
+	AtlasEntry& entry = entries[index];
+	if (entry.generation != static_cast<unsigned int>(image) >> kEntryIndexBits) return NULL;
+	return &entry;
+}
+
+static LruList& LruFor(int cellSize) {
+	int sizeClass = 0;
+	while ((IMAGE_MIN_CELL_SIZE << sizeClass) < cellSize) sizeClass++;
+	return lruLists[sizeClass];
+}
+
+static void LruUnlink(int index) {
+	AtlasEntry& entry = entries[index];
+	LruList& lru = LruFor(pages[entry.page].cellSize);
+	if (entry.lruPrev >= 0) entries[entry.lruPrev].lruNext = entry.lruNext;
+	else lru.head = entry.lruNext;
+	if (entry.lruNext >= 0) entries[entry.lruNext].lruPrev = entry.lruPrev;
+	else lru.tail = entry.lruPrev;
+	entry.lruPrev = entry.lruNext = -1;
+}
+
+static void LruPushBack(int index) {
+	AtlasEntry& entry = entries[index];
+	LruList& lru = LruFor(pages[entry.page].cellSize);
+	entry.lruPrev = lru.tail;
+	entry.lruNext = -1;
+	if (lru.tail >= 0) entries[lru.tail].lruNext = index;
+	else lru.head = index;
+	lru.tail = index;
+}
+
+bool InitImageAtlas(int maxPages) {
+	maxPageCount = std::max(maxPages, 1);
+	const unsigned char gray[4] = { 128, 128, 128, 64 };
+	placeholderImage = AddAtlasImage(gray, 1, 1, 4, 1, 1);
+	// Stands in for every pending image, so it is never evicted
+	if (placeholderImage) LruUnlink(EntryIndex(placeholderImage));
+	return placeholderImage != 0;
+}
+
+void ShutdownImageAtlas() {
+	// Joins the workers before the state they report into goes away
+	delete decodePool;
+	decodePool = NULL;
+	decodedCells.clear();
+
+	for (AtlasPage& page : pages) DeleteTexture(page.texture);
+	pages.clear();
+	entries.clear();
+	freeEntries.clear();
+	for (LruList& lru : lruLists) lru.head = lru.tail = -1;
+	placeholderImage = 0;
+}
+
+static bool AddPage(int cellSize) {
+	if (static_cast<int>(pages.size()) >= maxPageCount) return false;
+
+	AtlasPage page;
+	page.cellSize = cellSize;
+	page.texture = 0;
+	page.cells.assign(CellsPerRow(cellSize) * CellsPerRow(cellSize), 0);
+	if (SoftwareRendering()) {
+		// The rasterizer samples level 0 only; cells are stored at their drawn size
+		page.pixels.assign(static_cast<size_t>(IMAGE_PAGE_SIZE) * IMAGE_PAGE_SIZE * 4, 0);
+		pages.push_back(page);
+		return true;
+	}
+	glGenTextures(1, &page.texture);
+	BindTexture2D(page.texture);
+	// Cells bring their own mip levels, so every level is allocated up front
+	for (int level = 0; level < CellLevels(cellSize); level++) {
+		glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, IMAGE_PAGE_SIZE >> level, IMAGE_PAGE_SIZE >> level, 0,
+			GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, CellLevels(cellSize) - 1);
+	pages.push_back(page);
+	return true;
+}
+
+static bool FindFreeCell(int cellSize, int& pageIndex, int& cellIndex) {
+	for (size_t p = 0; p < pages.size(); p++) {
+		if (pages[p].cellSize != cellSize) continue;
+		std::vector<ImageHandle>::iterator free = std::find(pages[p].cells.begin(), pages[p].cells.end(), 0);
+		if (free != pages[p].cells.end()) {
+			pageIndex = static_cast<int>(p);
+			cellIndex = static_cast<int>(free - pages[p].cells.begin());
+			return true;
+		}
+	}
+	return false;
+}
+
+// Marks the slot gone and queues it for reuse; handles to it stop resolving
+static void FreeEntry(int index) {
+	AtlasEntry& entry = entries[index];
+	entry.state = ENTRY_GONE;
+	entry.generation = (entry.generation + 1) & kGenerationMask;
+	freeEntries.push_back(index);
+}
+
+// Frees the least recently drawn cell of `cellSize` and returns where it was,
+// unless all of them were drawn this frame
+static bool EvictLeastRecentlyUsed(int cellSize, int& pageIndex, int& cellIndex) {
+	int oldest = LruFor(cellSize).head;
+	if (oldest < 0 || entries[oldest].lastUsed == frameCounter) return false;
+	AtlasEntry& entry = entries[oldest];
+	pageIndex = entry.page;
+	cellIndex = entry.cell;
+	pages[pageIndex].cells[cellIndex] = 0;
+	LruUnlink(oldest);
+	FreeEntry(oldest);
+	return true;
+}
+
+// Resamples RGBA `pixels` to the decoded size into the top left of the cell,
+// repeating the last row and column over the rest of it so mip levels do not
+// pull in whatever the cell held before
+static void FillCell(const unsigned char* pixels, int sourceWidth, int sourceHeight, DecodedCell& decoded) {
+	int cellSize = decoded.cellSize, width = decoded.width, height = decoded.height;
+	std::vector<unsigned char>& cell = decoded.pixels;
+	cell.resize(static_cast<size_t>(cellSize) * cellSize * 4);
+	ResampleArea(pixels, sourceWidth, sourceHeight, cell.data(), width, height, cellSize);
+
+	for (int y = 0; y < height; y++) {
+		unsigned char* row = &cell[static_cast<size_t>(y) * cellSize * 4];
+		for (int x = width; x < cellSize; x++) std::memcpy(row + x * 4, row + (width - 1) * 4, 4);
+	}
+	const unsigned char* last = &cell[static_cast<size_t>(height - 1) * cellSize * 4];
+	for (int y = height; y < cellSize; y++) {
+		std::memcpy(&cell[static_cast<size_t>(y) * cellSize * 4], last, static_cast<size_t>(cellSize) * 4);
+	}
+}
+
+// Appends each smaller level of the cell in `levels`, 2x2 box-filtered from
+// the one before
+static void BuildCellLevels(int cellSize, std::vector<unsigned char>& levels) {
+	size_t offset = 0;
+	for (int size = cellSize; size > 1; size /= 2) {
+		int half = size / 2;
+		size_t next = levels.size();
+		levels.resize(next + static_cast<size_t>(half) * half * 4);
+		const unsigned char* source = &levels[offset];
+		unsigned char* target = &levels[next];
+		for (int y = 0; y < half; y++) {
+			const unsigned char* row0 = source + static_cast<size_t>(y * 2) * size * 4;
+			const unsigned char* row1 = row0 + size * 4;
+			for (int x = 0; x < half; x++) {
+				for (int c = 0; c < 4; c++) {
+					unsigned int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] + row1[x * 8 + c] + row1[x * 8 + 4 + c];
+					target[(static_cast<size_t>(y) * half + x) * 4 + c] = static_cast<unsigned char>((sum + 2) / 4);
+				}
+			}
+		}
+		offset = next;
+	}
+}
+
+// Sets the size `decoded` is prepared at: the displayed size, kept within a
+// cell, and the cell that holds it
+static void SetDecodedSize(DecodedCell& decoded, int width, int height) {
+	decoded.width = std::min(std::max(width, 1), IMAGE_CELL_SIZE);
+	decoded.height = std::min(std::max(height, 1), IMAGE_CELL_SIZE);
+	decoded.cellSize = CellSizeFor(decoded.width, decoded.height);
+}
+
+static void PrepareCell(const unsigned char* pixels, int sourceWidth, int sourceHeight, DecodedCell& decoded) {
+	FillCell(pixels, sourceWidth, sourceHeight, decoded);
+	BuildCellLevels(decoded.cellSize, decoded.pixels);
+}
+
+// Texture cache first; otherwise decode, resample, and cache the result.
+// Runs on worker threads.
+static void DecodeCell(const std::string& path, DecodedCell& decoded) {
+	TRACE_ZONE("DecodeImage");
+	int levels = CellLevels(decoded.cellSize);
+	if (LoadCachedTexture(path.c_str(), decoded.width, decoded.height, decoded.cellSize, levels, decoded.cached)) return;
+
+	// JPEGs come out of the inverse DCT at the smallest of 1/2, 1/4 or 1/8
+	// size that still covers the cell's image; the area resample only does
+	// the rest
+	int sourceWidth, sourceHeight, channels;
+	stbi_set_jpeg_min_size_on_load_thread(decoded.width, decoded.height);
+	unsigned char* data = stbi_load(path.c_str(), &sourceWidth, &sourceHeight, &channels, 4);
+	stbi_set_jpeg_min_size_on_load_thread(0, 0);
+	if (!data) {
+		std::cerr << "Texture failed to load at path: " << path << std::endl;
+		return;
+	}
+	PrepareCell(data, sourceWidth, sourceHeight, decoded);
+	stbi_image_free(data);
+	StoreCachedTexture(path.c_str(), decoded.width, decoded.height, decoded.cellSize, levels,
+		decoded.pixels.data(), decoded.pixels.size());
+}
+
+// Uploads every level of a prepared cell for `image`, which must not hold one yet
+static bool PlaceCell(ImageHandle image, const DecodedCell& decoded) {
+	TRACE_ZONE("UploadImage");
+	int cellSize = decoded.cellSize;
+	int pageIndex, cellIndex;
+	if (!FindFreeCell(cellSize, pageIndex, cellIndex)) {
+		if (AddPage(cellSize)) {
+			FindFreeCell(cellSize, pageIndex, cellIndex);
+		}
+		else if (!EvictLeastRecentlyUsed(cellSize, pageIndex, cellIndex)) {
+			std::cerr << "ERROR::ATLAS: No free image cell" << std::endl;
+			return false;
+		}
+	}
+
+	AtlasPage& page = pages[pageIndex];
+	const unsigned char* levels = decoded.Levels();
+	int cellX = (cellIndex % CellsPerRow(cellSize)) * cellSize;
+	int cellY = (cellIndex / CellsPerRow(cellSize)) * cellSize;
+	if (!page.pixels.empty()) {
+		for (int row = 0; row < cellSize; row++) {
+			unsigned char* target = &page.pixels[(static_cast<size_t>(cellY + row) * IMAGE_PAGE_SIZE + cellX) * 4];
+			std::memcpy(target, levels + static_cast<size_t>(row) * cellSize * 4, static_cast<size_t>(cellSize) * 4);
+		}
+	}
+	else {
+		BindTexture2D(page.texture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		for (int level = 0; level < CellLevels(cellSize); level++) {
+			int size = cellSize >> level;
+			glTexSubImage2D(GL_TEXTURE_2D, level, cellX >> level, cellY >> level, size, size, GL_RGBA, GL_UNSIGNED_BYTE, levels);
+			CountTextureUpload(static_cast<size_t>(size) * size * 4);
+			levels += static_cast<size_t>(size) * size * 4;
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	}
+	page.cells[cellIndex] = image;
+
+	AtlasEntry& entry = entries[EntryIndex(image)];
+	entry.state = ENTRY_READY;
+	entry.page = pageIndex;
+	entry.cell = cellIndex;
+	entry.width = decoded.width;
+	entry.height = decoded.height;
+	entry.lastUsed = frameCounter;
+	LruPushBack(EntryIndex(image));
+	return true;
+}
+
+// A freed slot when there is one; 0 once the table is full
+static ImageHandle NewEntry(AtlasEntryState state) {
+	int index;
+	if (!freeEntries.empty()) {
+		index = freeEntries.back();
+		freeEntries.pop_back();
+	}
+	else {
+		if (static_cast<int>(entries.size()) >= kEntryIndexMask) {
+			std::cerr << "ERROR::ATLAS: Image table is full" << std::endl;
+			return 0;
+		}
+		index = static_cast<int>(entries.size());
+		entries.push_back(AtlasEntry());
+		entries[index].generation = 0;
+	}
+	AtlasEntry& entry = entries[index];
+	entry.state = state;
+	entry.page = entry.cell = -1;
+	entry.width = entry.height = 0;
+	entry.lastUsed = frameCounter;
+	entry.lruPrev = entry.lruNext = -1;
+	return EntryHandle(index);
+}
+
+ImageHandle AddAtlasImage(const unsigned char* pixels, int sourceWidth, int sourceHeight, int channels,
+	int width, int height) {
+	if (!pixels || sourceWidth <= 0 || sourceHeight <= 0 || channels < 1 || channels > 4) return 0;
+
+	// The resampler takes RGBA only
+	size_t count = static_cast<size_t>(sourceWidth) * sourceHeight;
+	std::vector<unsigned char> rgba(count * 4);
+	for (size_t i = 0; i < count; i++) {
+		const unsigned char* p = pixels + i * channels;
+		unsigned char* out = &rgba[i * 4];
+		out[0] = p[0];
+		out[1] = channels >= 3 ? p[1] : p[0];
+		out[2] = channels >= 3 ? p[2] : p[0];
+		out[3] = channels == 4 ? p[3] : (channels == 2 ? p[1] : 255);
+	}
+
+	DecodedCell decoded;
+	SetDecodedSize(decoded, width, height);
+	PrepareCell(rgba.data(), sourceWidth, sourceHeight, decoded);
+
+	ImageHandle handle = NewEntry(ENTRY_PENDING);
+	if (!handle) return 0;
+	if (!PlaceCell(handle, decoded)) {
+		FreeEntry(EntryIndex(handle));
+		return 0;
+	}
+	return handle;
+}
+
+ImageHandle LoadAtlasImage(const char* path, int width, int height) {
+	TRACE_ZONE("LoadTexture");
+	DecodedCell decoded;
+	SetDecodedSize(decoded, width, height);
+	DecodeCell(path, decoded);
+	if (!decoded.Levels()) return 0;
+
+	ImageHandle handle = NewEntry(ENTRY_PENDING);
+	if (!handle) return 0;
+	if (!PlaceCell(handle, decoded)) {
+		FreeEntry(EntryIndex(handle));
+		return 0;
+	}
+	return handle;
+}
+
+ImageHandle LoadAtlasImageAsync(const char* path, int width, int height) {
+	if (!decodePool) decodePool = new WorkerPool();
+
+	ImageHandle handle = NewEntry(ENTRY_PENDING);
+	if (!handle) return 0;
+	std::string source = path;
+	decodePool->Submit([handle, source, width, height] {
+		DecodedCell decoded;
+		decoded.image = handle;
+		SetDecodedSize(decoded, width, height);
+		DecodeCell(source, decoded);
+
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+			decodedCells.push_back(std::move(decoded));
+		}
+		if (decodedCallback) decodedCallback();
+	});
+	return handle;
+}
+
+void SetImageDecodedCallback(void (*callback)()) {
+	decodedCallback = callback;
+}
+
+void ReleaseAtlasImage(ImageHandle image) {
+	AtlasEntry* entry = FindEntry(image);
+	if (!entry || image == placeholderImage) return;
+	if (entry->state == ENTRY_READY) {
+		pages[entry->page].cells[entry->cell] = 0;
+		LruUnlink(EntryIndex(image));
+	}
+	// A pending decode no longer matches the slot's generation and is
+	// dropped on arrival
+	FreeEntry(EntryIndex(image));
+}
+
+// Entry drawn for `image`, which is the placeholder's while it is pending,
+// and its texcoords; NULL when there is nothing to draw
+static AtlasEntry* ResolveEntry(ImageHandle image, glm::vec4& uv) {
+	AtlasEntry* found = FindEntry(image);
+	if (!found) return NULL;
+	if (found->state == ENTRY_PENDING || found->state == ENTRY_FAILED) {
+		if (image == placeholderImage) return NULL;
+		image = placeholderImage;
+		found = FindEntry(image);
+	}
+	if (!found || found->state != ENTRY_READY) return NULL;
+	AtlasEntry& entry = *found;
+	if (entry.lastUsed != frameCounter && image != placeholderImage) {
+		// Keeps each LRU list in order of lastUsed
+		LruUnlink(EntryIndex(image));
+		entry.lastUsed = frameCounter;
+		LruPushBack(EntryIndex(image));
+	}
+
+	// Inset by half a texel so linear filtering stays inside the image
+	const float texel = 1.0f / IMAGE_PAGE_SIZE;
+	int cellSize = pages[entry.page].cellSize;
+	float left = (entry.cell % CellsPerRow(cellSize)) * cellSize + 0.5f;
+	float top = (entry.cell / CellsPerRow(cellSize)) * cellSize + 0.5f;
+	float right = left + entry.width - 1.0f;
+	float bottom = top + entry.height - 1.0f;
+	// Rows were uploaded top first, so the image's bottom edge is at `bottom`
+	uv = glm::vec4(left * texel, bottom * texel, right * texel, top * texel);
+	return &entry;
+}
+
+bool ResolveAtlasImage(ImageHandle image, unsigned int& texture, glm::vec4& uv) {
+	AtlasEntry* entry = ResolveEntry(image, uv);
+	if (!entry) return false;
+	texture = pages[entry->page].texture;
+	return true;
+}
+
+bool ResolveAtlasPixels(ImageHandle image, const unsigned char*& pixels, glm::vec4& uv) {
+	AtlasEntry* entry = ResolveEntry(image, uv);
+	if (!entry || pages[entry->page].pixels.empty()) return false;
+	pixels = pages[entry->page].pixels.data();
+	return true;
+}
+
+void UpdateImageAtlas() {
+	frameCounter++;
+}
+
+void UploadDecodedImages(double budgetMilliseconds, std::vector<ImageHandle>& uploaded) {
+	typedef std::chrono::steady_clock Clock;
+	Clock::time_point start = Clock::now();
+
+	// At least one per call, so a tiny budget still makes progress
+	for (;;) {
+		DecodedCell decoded;
+		{
+			std::lock_guard<std::mutex> lock(decodedMutex);
+			if (decodedCells.empty()) return;
+			decoded = std::move(decodedCells.front());
+			decodedCells.erase(decodedCells.begin());
+		}
+
+		AtlasEntry* entry = FindEntry(decoded.image);
+		if (entry && entry->state == ENTRY_PENDING) {
+			if (!decoded.Levels()) entry->state = ENTRY_FAILED;
+			else if (PlaceCell(decoded.image, decoded)) uploaded.push_back(decoded.image);
+			else entry->state = ENTRY_FAILED;
+		}
+
+		std::chrono::duration<double, std::milli> elapsed = Clock::now() - start;
+		if (elapsed.count() >= budgetMilliseconds) return;
+	}
+}
+
+bool ImageUploadsPending() {
+	std::lock_guard<std::mutex> lock(decodedMutex);
+	return !decodedCells.empty();
+}
+
+void FinishImageDecodes() {
+	std::vector<ImageHandle> uploaded;
+	for (;;) {
+		UploadDecodedImages(1e9, uploaded);
+		bool pending = false;
+		for (const AtlasEntry& entry : entries) pending |= entry.state == ENTRY_PENDING;
+		if (!pending) return;
+		// Every queued decode reports back, even one that failed
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
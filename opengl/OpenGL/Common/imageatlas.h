@@ -0,0 +1,64 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <vector>
+
+// Product photos and avatars share a few large RGBA pages instead of one
+// texture each, so the quad batch can draw a whole grid of them in one call.
+// Images are area-resampled once, at decode time, to the size they are drawn
+// at, and get the smallest power-of-two square cell that holds them; each page
+// holds cells of one size. Cells sit on power-of-two boundaries and carry their
+// own mip levels, so no level ever mixes two images and pages never run
+// glGenerateMipmap. With a texture cache directory set, prepared cells are
+// reused across runs.
+const int IMAGE_PAGE_SIZE = 2048;
+const int IMAGE_CELL_SIZE = 256;    // largest cell, and so the largest stored image
+const int IMAGE_MIN_CELL_SIZE = 32;
+
+// Slot in the atlas' image table and the slot's generation; 0 is never a
+// valid image. Slots are reused, so eviction and release cost the same however
+// many images came and went, and old handles simply stop resolving.
+typedef int ImageHandle;
+
+bool InitImageAtlas(int maxPages = 4);
+void ShutdownImageAtlas();
+
+// Decodes `path`, resamples it to width x height (its displayed size, capped
+// at IMAGE_CELL_SIZE) and copies it into a free cell, evicting the least
+// recently drawn image of that cell size when every page is full. Returns 0
+// on failure.
+ImageHandle LoadAtlasImage(const char* path, int width = IMAGE_CELL_SIZE, int height = IMAGE_CELL_SIZE);
+// Same for pixels already in memory, `channels` bytes per pixel, rows top first
+ImageHandle AddAtlasImage(const unsigned char* pixels, int sourceWidth, int sourceHeight, int channels,
+	int width = IMAGE_CELL_SIZE, int height = IMAGE_CELL_SIZE);
+// Returns at once and decodes on a worker thread; the handle draws as a
+// placeholder until UploadDecodedImages() has copied the result in
+ImageHandle LoadAtlasImageAsync(const char* path, int width = IMAGE_CELL_SIZE, int height = IMAGE_CELL_SIZE);
+// Frees the cell; the handle stops resolving
+void ReleaseAtlasImage(ImageHandle image);
+
+// Page texture and upright texcoords (as BatchTexturedRect takes them) of a
+// live image, or of the placeholder while it is still decoding or failed to.
+// Counts as a use for eviction. False once evicted or released.
+bool ResolveAtlasImage(ImageHandle image, unsigned int& texture, glm::vec4& uv);
+// Same for the software rasterizer: the page's level 0 as RGBA rows of
+// IMAGE_PAGE_SIZE texels, top first. False when pages live in GL textures.
+bool ResolveAtlasPixels(ImageHandle image, const unsigned char*& pixels, glm::vec4& uv);
+
+// Call once per frame before drawing; images resolved after it count as
+// drawn this frame and are safe from eviction until the next call
+void UpdateImageAtlas();
+
+// Share of a 60 Hz frame the apps give to texture uploads
+const double IMAGE_UPLOAD_BUDGET_MS = 4.0;
+
+// Copies finished decodes into the atlas until `budgetMilliseconds` is spent,
+// at least one per call, and appends the handles that became drawable
+void UploadDecodedImages(double budgetMilliseconds, std::vector<ImageHandle>& uploaded);
+// Whether decodes are waiting for UploadDecodedImages()
+bool ImageUploadsPending();
+// Blocks until every image loaded so far is decoded and copied in, for a
+// headless frame that has to show them all
+void FinishImageDecodes();
+// Called from a worker thread after each decode, e.g. glfwPostEmptyEvent to
+// wake a loop sleeping in glfwWaitEvents
+void SetImageDecodedCallback(void (*callback)());
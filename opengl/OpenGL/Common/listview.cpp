@@ -0,0 +1,137 @@
+#include "listview.h"
+#include <algorithm>
+#include <cmath>
+
+// Share of the remaining distance covered per second is 1 - e^-rate, which
+// settles a wheel step in about a quarter of a second
+static const double kScrollRate = 18.0;
+// Closer than this the offset jumps onto the target
+static const double kScrollSnap = 0.5;
+// Longer steps, such as the first one after the loop slept, count as this
+static const double kMaxStep = 1.0 / 30.0;
+
+void SmoothScroll::SetLimit(double maxOffset) {
+	limit = std::max(0.0, maxOffset);
+	ScrollTo(target, false);
+}
+
+void SmoothScroll::ScrollTo(double to, bool animate) {
+	target = std::min(std::max(to, 0.0), limit);
+	if (!animate) offset = target;
+}
+
+bool SmoothScroll::Step(double seconds) {
+	double remaining = target - offset;
+	offset += remaining * (1.0 - std::exp(-kScrollRate * std::min(seconds, kMaxStep)));
+	if (std::fabs(target - offset) < kScrollSnap) offset = target;
+	return Scrolling();
+}
+
+ListView::ListView() : viewport(0.0f), offsets(1, 0.0) {
+}
+
+void ListView::SetViewport(glm::vec4 area) {
+	viewport = area;
+	UpdateScrollLimit();
+}
+
+void ListView::AddRow(float height) {
+	offsets.push_back(offsets.back() + height);
+	UpdateScrollLimit();
+}
+
+void ListView::AddRows(size_t count, float height) {
+	offsets.reserve(offsets.size() + count);
+	for (size_t i = 0; i < count; i++) offsets.push_back(offsets.back() + height);
+	UpdateScrollLimit();
+}
+
+void ListView::Clear() {
+	offsets.assign(1, 0.0);
+	UpdateScrollLimit();
+}
+
+void ListView::UpdateScrollLimit() {
+	scroll.SetLimit(ContentHeight() - viewport.w);
+}
+
+size_t ListView::RowContaining(double contentY) const {
+	// offsets[0] is 0, so the result is at least row 0
+	return static_cast<size_t>(std::upper_bound(offsets.begin(), offsets.end(), contentY) - offsets.begin()) - 1;
+}
+
+void ListView::VisibleRows(size_t& first, size_t& last) const {
+	if (RowCount() == 0) {
+		first = last = 0;
+		return;
+	}
+	double offset = scroll.Offset();
+	first = std::min(RowContaining(offset), RowCount());
+	// The row holding the bottom edge is the last one showing any of itself
+	last = std::min(RowContaining(offset + viewport.w) + 1, RowCount());
+	if (offsets[last - 1] >= offset + viewport.w) last--;
+}
+
+float ListView::RowBottom(size_t row) const {
+	double top = viewport.y + viewport.w;
+	return static_cast<float>(std::round(top - (offsets[row + 1] - scroll.Offset())));
+}
+
+bool ListView::RowAt(float x, float y, size_t& row) const {
+	if (x < viewport.x || x >= viewport.x + viewport.z || y < viewport.y || y >= viewport.y + viewport.w) return false;
+	double contentY = scroll.Offset() + (viewport.y + viewport.w - y);
+	if (contentY >= ContentHeight()) return false;
+	row = RowContaining(contentY);
+	return true;
+}
+
+GridView::GridView() : viewport(0.0f), columns(1), cellSize(1.0f), itemCount(0) {
+}
+
+void GridView::SetViewport(glm::vec4 area) {
+	viewport = area;
+	UpdateScrollLimit();
+}
+
+void GridView::SetLayout(int columnCount, glm::vec2 size) {
+	columns = std::max(columnCount, 1);
+	cellSize = size;
+	UpdateScrollLimit();
+}
+
+void GridView::SetItemCount(size_t count) {
+	itemCount = count;
+	UpdateScrollLimit();
+}
+
+void GridView::UpdateScrollLimit() {
+	scroll.SetLimit(RowCount() * static_cast<double>(cellSize.y) - viewport.w);
+}
+
+void GridView::VisibleRows(size_t& first, size_t& last, size_t margin) const {
+	double offset = scroll.Offset();
+	size_t top = static_cast<size_t>(offset / cellSize.y);
+	// A row starting exactly at the bottom edge shows nothing
+	size_t bottom = static_cast<size_t>(std::ceil((offset + viewport.w) / cellSize.y));
+	first = top > margin ? top - margin : 0;
+	last = std::min(bottom + margin, RowCount());
+	first = std::min(first, last);
+}
+
+float GridView::RowBottom(size_t row) const {
+	double top = viewport.y + viewport.w;
+	return static_cast<float>(std::round(top - ((row + 1) * static_cast<double>(cellSize.y) - scroll.Offset())));
+}
+
+glm::vec2 GridView::CellOrigin(size_t item) const {
+	return glm::vec2(viewport.x + (item % columns) * cellSize.x, RowBottom(item / columns));
+}
+
+bool GridView::ItemAt(float x, float y, size_t& item) const {
+	if (x < viewport.x || x >= viewport.x + viewport.z || y < viewport.y || y >= viewport.y + viewport.w) return false;
+	size_t column = static_cast<size_t>((x - viewport.x) / cellSize.x);
+	if (column >= static_cast<size_t>(columns)) return false;
+	double contentY = scroll.Offset() + (viewport.y + viewport.w - y);
+	item = static_cast<size_t>(contentY / cellSize.y) * columns + column;
+	return item < itemCount;
+}
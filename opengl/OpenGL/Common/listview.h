@@ -0,0 +1,116 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+// Scroll offset that eases towards its target a little every frame
+class SmoothScroll {
+public:
+	SmoothScroll() : offset(0.0), target(0.0), limit(0.0) {}
+
+	double Offset() const { return offset; }
+	// Largest offset; the target is clamped to [0, limit]
+	void SetLimit(double maxOffset);
+	void ScrollBy(double delta) { ScrollTo(target + delta); }
+	void ScrollTo(double to, bool animate = true);
+	// Advances by `seconds`; true while the offset still moves
+	bool Step(double seconds);
+	bool Scrolling() const { return offset != target; }
+
+private:
+	double offset;
+	double target;
+	double limit;
+};
+
+// Vertical list of rows inside a fixed viewport. Each row keeps only the
+// offset where it starts, so finding the rows on screen is a binary search
+// and the caller binds a handful of recycled scene nodes to them, whatever
+// the row count.
+class ListView {
+public:
+	ListView();
+
+	// Viewport as (x, y, width, height) in scene units; row 0 starts at its top
+	void SetViewport(glm::vec4 viewport);
+	glm::vec4 Viewport() const { return viewport; }
+
+	void AddRow(float height);
+	// Appends `count` rows of the same height in one go
+	void AddRows(size_t count, float height);
+	void Clear();
+	size_t RowCount() const { return offsets.size() - 1; }
+	double ContentHeight() const { return offsets.back(); }
+
+	// Distance from the top of row 0 to the top of the viewport. ScrollBy and
+	// ScrollTo move the target, clamped to the content, and Step() eases the
+	// offset towards it.
+	double ScrollOffset() const { return scroll.Offset(); }
+	void ScrollBy(double delta) { scroll.ScrollBy(delta); }
+	void ScrollTo(double target, bool animate = true) { scroll.ScrollTo(target, animate); }
+	bool Step(double seconds) { return scroll.Step(seconds); }
+	bool Scrolling() const { return scroll.Scrolling(); }
+
+	// Rows that intersect the viewport, as [first, last)
+	void VisibleRows(size_t& first, size_t& last) const;
+	// Scene y of a row's bottom edge at the current offset, on a whole unit so
+	// text and images do not shimmer while scrolling
+	float RowBottom(size_t row) const;
+	float RowHeight(size_t row) const { return static_cast<float>(offsets[row + 1] - offsets[row]); }
+	// Row under a scene point; false outside the viewport or past the last row
+	bool RowAt(float x, float y, size_t& row) const;
+
+private:
+	void UpdateScrollLimit();
+	// First row that ends below `contentY`
+	size_t RowContaining(double contentY) const;
+
+	glm::vec4 viewport;
+	std::vector<double> offsets; // top of each row, then the content height
+	SmoothScroll scroll;
+};
+
+// Grid of equal cells filled left to right, then top to bottom, inside a
+// fixed viewport. Positions are computed from an item's index, so the grid
+// stores nothing per item and any item count costs the same to scroll.
+class GridView {
+public:
+	GridView();
+
+	// Viewport as (x, y, width, height) in scene units; row 0 starts at its top
+	void SetViewport(glm::vec4 viewport);
+	glm::vec4 Viewport() const { return viewport; }
+	void SetLayout(int columns, glm::vec2 cellSize);
+	void SetItemCount(size_t count);
+
+	size_t ItemCount() const { return itemCount; }
+	int Columns() const { return columns; }
+	glm::vec2 CellSize() const { return cellSize; }
+	size_t RowCount() const { return (itemCount + columns - 1) / columns; }
+
+	// As in ListView
+	double ScrollOffset() const { return scroll.Offset(); }
+	void ScrollBy(double delta) { scroll.ScrollBy(delta); }
+	void ScrollTo(double target, bool animate = true) { scroll.ScrollTo(target, animate); }
+	bool Step(double seconds) { return scroll.Step(seconds); }
+	bool Scrolling() const { return scroll.Scrolling(); }
+
+	// Rows that intersect the viewport widened by `margin` rows on both
+	// sides, as [first, last)
+	void VisibleRows(size_t& first, size_t& last, size_t margin = 0) const;
+	// Scene y of a row's bottom edge at the current offset, on a whole unit
+	float RowBottom(size_t row) const;
+	// Bottom-left corner of an item's cell
+	glm::vec2 CellOrigin(size_t item) const;
+	// Item under a scene point; false outside the viewport or past the last item
+	bool ItemAt(float x, float y, size_t& item) const;
+
+private:
+	void UpdateScrollLimit();
+
+	glm::vec4 viewport;
+	int columns;
+	glm::vec2 cellSize;
+	size_t itemCount;
+	SmoothScroll scroll;
+};
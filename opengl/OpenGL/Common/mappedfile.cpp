@@ -0,0 +1,105 @@
+#include "mappedfile.h"
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cerrno>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <direct.h>
+
+bool MappedFile::Open(const char* path) {
+	Close();
+	HANDLE handle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (handle == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER length;
+	if (!GetFileSizeEx(handle, &length) || length.QuadPart == 0) {
+		CloseHandle(handle);
+		return false;
+	}
+	HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!view) {
+		CloseHandle(handle);
+		return false;
+	}
+	void* address = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+	if (!address) {
+		CloseHandle(view);
+		CloseHandle(handle);
+		return false;
+	}
+
+	file = handle;
+	mapping = view;
+	data = static_cast<const unsigned char*>(address);
+	size = static_cast<size_t>(length.QuadPart);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) UnmapViewOfFile(data);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+	data = nullptr;
+	size = 0;
+	mapping = nullptr;
+	file = nullptr;
+}
+
+bool GetFileStamp(const char* path, unsigned long long& size, long long& modified) {
+	struct _stat64 info;
+	if (_stat64(path, &info) != 0) return false;
+	size = static_cast<unsigned long long>(info.st_size);
+	modified = static_cast<long long>(info.st_mtime);
+	return true;
+}
+
+bool MakeDirectory(const char* path) {
+	return _mkdir(path) == 0 || errno == EEXIST;
+}
+
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+bool MappedFile::Open(const char* path) {
+	Close();
+	int descriptor = open(path, O_RDONLY);
+	if (descriptor < 0) return false;
+
+	struct stat info;
+	if (fstat(descriptor, &info) != 0 || info.st_size == 0) {
+		close(descriptor);
+		return false;
+	}
+	void* address = mmap(NULL, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, descriptor, 0);
+	// The mapping keeps the file alive on its own
+	close(descriptor);
+	if (address == MAP_FAILED) return false;
+
+	data = static_cast<const unsigned char*>(address);
+	size = static_cast<size_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::Close() {
+	if (data) munmap(const_cast<unsigned char*>(data), size);
+	data = nullptr;
+	size = 0;
+}
+
+bool GetFileStamp(const char* path, unsigned long long& size, long long& modified) {
+	struct stat info;
+	if (stat(path, &info) != 0) return false;
+	size = static_cast<unsigned long long>(info.st_size);
+	modified = static_cast<long long>(info.st_mtime);
+	return true;
+}
+
+bool MakeDirectory(const char* path) {
+	return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+#endif
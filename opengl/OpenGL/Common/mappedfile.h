@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+
+// Read-only view of a whole file through the OS page cache (MapViewOfFile on
+// Windows, mmap elsewhere). Nothing is read until a page is touched.
+class MappedFile {
+public:
+	MappedFile() {}
+	~MappedFile() { Close(); }
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool Open(const char* path);
+	void Close();
+
+	const unsigned char* Data() const { return data; }
+	size_t Size() const { return size; }
+
+private:
+	const unsigned char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
+
+// Size in bytes and last modification time (seconds since the epoch)
+bool GetFileStamp(const char* path, unsigned long long& size, long long& modified);
+// Creates `path` unless it exists; its parent must exist
+bool MakeDirectory(const char* path);
@@ -0,0 +1,14 @@
+#include "messagestore.h"
+
+size_t MessageStore::Add(StringRef senderName, StringRef body, int64_t timestamp) {
+	senders.push_back(names.Intern(senderName));
+	bodies.Add(body);
+	timestamps.push_back(timestamp);
+	return senders.size() - 1;
+}
+
+void MessageStore::Reserve(size_t messages, size_t bodyBytes) {
+	senders.reserve(messages);
+	bodies.Reserve(messages, bodyBytes);
+	timestamps.reserve(messages);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "stringpool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+typedef uint32_t SenderId;
+
+// One message as the render path reads it; nothing is copied, the strings
+// point into the store
+struct MessageView {
+	SenderId sender;
+	StringRef senderName;
+	StringRef body;
+	int64_t timestamp; // seconds since the epoch
+};
+
+// Messages kept column by column: sender ids into an interned name table,
+// bodies back to back in one UTF-8 arena, and numeric timestamps. A loop that
+// needs one field reads only that column, front to back.
+class MessageStore {
+public:
+	size_t Add(StringRef senderName, StringRef body, int64_t timestamp);
+	void Reserve(size_t messages, size_t bodyBytes);
+
+	size_t Count() const { return senders.size(); }
+	MessageView operator[](size_t message) const {
+		MessageView view = { senders[message], names.Get(senders[message]), bodies.Get(static_cast<uint32_t>(message)),
+			timestamps[message] };
+		return view;
+	}
+
+	// Columns, for loops over a single field
+	const std::vector<SenderId>& Senders() const { return senders; }
+	const std::vector<int64_t>& Timestamps() const { return timestamps; }
+	StringRef Body(size_t message) const { return bodies.Get(static_cast<uint32_t>(message)); }
+	const StringArena& Bodies() const { return bodies; }
+
+	size_t SenderCount() const { return names.Count(); }
+	StringRef SenderName(SenderId sender) const { return names.Get(sender); }
+
+private:
+	StringTable names;
+	std::vector<SenderId> senders;
+	StringArena bodies;
+	std::vector<int64_t> timestamps;
+};
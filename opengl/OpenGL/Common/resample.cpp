@@ -0,0 +1,126 @@
+#include "resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Source pixels feeding one target pixel along one axis
+struct Span {
+	int first, count;
+	size_t weights; // index of the first weight
+};
+
+static void BuildSpans(int sourceSize, int targetSize, std::vector<Span>& spans, std::vector<float>& weights) {
+	double scale = static_cast<double>(sourceSize) / targetSize;
+	spans.resize(targetSize);
+	weights.clear();
+	for (int i = 0; i < targetSize; i++) {
+		double begin = i * scale;
+		double end = std::min((i + 1) * scale, static_cast<double>(sourceSize));
+		int first = static_cast<int>(std::floor(begin));
+		int last = std::min(static_cast<int>(std::ceil(end)), sourceSize) - 1;
+		if (last < first) last = first;
+
+		Span& span = spans[i];
+		span.first = first;
+		span.count = last - first + 1;
+		span.weights = weights.size();
+		double total = 0.0;
+		for (int s = first; s <= last; s++) {
+			double coverage = std::min(end, s + 1.0) - std::max(begin, static_cast<double>(s));
+			weights.push_back(static_cast<float>(std::max(coverage, 0.0)));
+			total += std::max(coverage, 0.0);
+		}
+		// Normalize so flat areas keep their exact value
+		for (int k = 0; k < span.count; k++) {
+			weights[span.weights + k] = total > 0.0 ? static_cast<float>(weights[span.weights + k] / total) : 1.0f / span.count;
+		}
+	}
+}
+
+#ifdef RESAMPLE_SSE2
+static inline __m128 LoadPixel(const unsigned char* p) {
+	int bits;
+	std::memcpy(&bits, p, 4);
+	__m128i zero = _mm_setzero_si128();
+	__m128i wide = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bits), zero), zero);
+	return _mm_cvtepi32_ps(wide);
+}
+
+static inline void StorePixel(unsigned char* p, __m128 value) {
+	__m128i rounded = _mm_cvtps_epi32(value);
+	__m128i packed = _mm_packus_epi16(_mm_packs_epi32(rounded, rounded), rounded);
+	int bits = _mm_cvtsi128_si32(packed);
+	std::memcpy(p, &bits, 4);
+}
+#endif
+
+void ResampleArea(const unsigned char* source, int sourceWidth, int sourceHeight,
+	unsigned char* target, int targetWidth, int targetHeight, int targetStride) {
+	if (sourceWidth <= 0 || sourceHeight <= 0 || targetWidth <= 0 || targetHeight <= 0) return;
+
+	std::vector<Span> columns, rows;
+	std::vector<float> columnWeights, rowWeights;
+	BuildSpans(sourceWidth, targetWidth, columns, columnWeights);
+	BuildSpans(sourceHeight, targetHeight, rows, rowWeights);
+
+	// Horizontal pass into float RGBA, one row per source row
+	std::vector<float> horizontal(static_cast<size_t>(sourceHeight) * targetWidth * 4);
+	for (int y = 0; y < sourceHeight; y++) {
+		const unsigned char* in = source + static_cast<size_t>(y) * sourceWidth * 4;
+		float* out = &horizontal[static_cast<size_t>(y) * targetWidth * 4];
+		for (int x = 0; x < targetWidth; x++) {
+			const Span& span = columns[x];
+			const float* w = &columnWeights[span.weights];
+			const unsigned char* p = in + static_cast<size_t>(span.first) * 4;
+#ifdef RESAMPLE_SSE2
+			__m128 sum = _mm_setzero_ps();
+			for (int k = 0; k < span.count; k++) sum = _mm_add_ps(sum, _mm_mul_ps(LoadPixel(p + k * 4), _mm_set1_ps(w[k])));
+			_mm_storeu_ps(out + x * 4, sum);
+#else
+			float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int k = 0; k < span.count; k++) {
+				for (int c = 0; c < 4; c++) sum[c] += p[k * 4 + c] * w[k];
+			}
+			std::memcpy(out + x * 4, sum, sizeof(sum));
+#endif
+		}
+	}
+
+	// Vertical pass, walking whole rows so the reads stay sequential
+	std::vector<float> accumulator(static_cast<size_t>(targetWidth) * 4);
+	for (int y = 0; y < targetHeight; y++) {
+		const Span& span = rows[y];
+		const float* w = &rowWeights[span.weights];
+		std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+		for (int k = 0; k < span.count; k++) {
+			const float* in = &horizontal[static_cast<size_t>(span.first + k) * targetWidth * 4];
+#ifdef RESAMPLE_SSE2
+			__m128 weight = _mm_set1_ps(w[k]);
+			for (int x = 0; x < targetWidth; x++) {
+				__m128 sum = _mm_loadu_ps(&accumulator[x * 4]);
+				_mm_storeu_ps(&accumulator[x * 4], _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(in + x * 4), weight)));
+			}
+#else
+			for (int i = 0; i < targetWidth * 4; i++) accumulator[i] += in[i] * w[k];
+#endif
+		}
+
+		unsigned char* out = target + static_cast<size_t>(y) * targetStride * 4;
+		for (int x = 0; x < targetWidth; x++) {
+#ifdef RESAMPLE_SSE2
+			StorePixel(out + x * 4, _mm_loadu_ps(&accumulator[x * 4]));
+#else
+			for (int c = 0; c < 4; c++) {
+				float value = accumulator[x * 4 + c] + 0.5f;
+				out[x * 4 + c] = static_cast<unsigned char>(std::min(std::max(value, 0.0f), 255.0f));
+			}
+#endif
+		}
+	}
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+// Area-averaging resize of RGBA8 pixels: each target pixel is the mean of the
+// source area it covers, partial pixels weighted by coverage. Separable, with
+// SSE2 doing one RGBA pixel per register where the compiler targets it.
+// `targetStride` is in pixels, so the result can land inside a larger image.
+void ResampleArea(const unsigned char* source, int sourceWidth, int sourceHeight,
+	unsigned char* target, int targetWidth, int targetHeight, int targetStride);
@@ -0,0 +1,245 @@
+#include "scene.h"
+#include "batch.h"
+#include "glstate.h"
+#include "softraster.h"
+#include "text.h"
+#include "trace.h"
+#include <glad/glad.h>
+#include <algorithm>
+
+SceneNodeId Scene::Add(const SceneNode& node) {
+	nodes.push_back(node);
+	dirty.push_back(1);
+	drawnBounds.push_back(glm::vec4(0.0f));
+	anyDirty = true;
+	return static_cast<SceneNodeId>(nodes.size() - 1);
+}
+
+static SceneNode MakeNode(SceneNodeKind kind, unsigned int program, unsigned int texture,
+	float x, float y, float width, float height, glm::vec4 color) {
+	SceneNode node;
+	node.kind = kind;
+	node.program = program;
+	node.texture = texture;
+	node.image = 0;
+	node.x = x;
+	node.y = y;
+	node.width = width;
+	node.height = height;
+	node.radius = 0.0f;
+	node.scale = 1.0f;
+	node.font = FONT_REGULAR;
+	node.uv = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+	node.color = color;
+	node.visible = true;
+	return node;
+}
+
+SceneNodeId Scene::AddRect(unsigned int program, float x, float y, float width, float height, glm::vec4 color) {
+	return Add(MakeNode(SCENE_RECT, program, 0, x, y, width, height, color));
+}
+
+SceneNodeId Scene::AddRoundedRect(unsigned int program, float x, float y, float width, float height, float radius, glm::vec4 color) {
+	SceneNode node = MakeNode(SCENE_ROUNDED_RECT, program, 0, x, y, width, height, color);
+	node.radius = radius;
+	return Add(node);
+}
+
+SceneNodeId Scene::AddImage(unsigned int program, unsigned int texture, float x, float y, float width, float height, glm::vec4 uv) {
+	SceneNode node = MakeNode(SCENE_IMAGE, program, texture, x, y, width, height, glm::vec4(1.0f));
+	node.uv = uv;
+	return Add(node);
+}
+
+SceneNodeId Scene::AddAtlasImage(unsigned int program, ImageHandle image, float x, float y, float width, float height) {
+	SceneNode node = MakeNode(SCENE_ATLAS_IMAGE, program, 0, x, y, width, height, glm::vec4(1.0f));
+	node.image = image;
+	return Add(node);
+}
+
+SceneNodeId Scene::AddText(unsigned int program, const std::string& text, float x, float y, float scale, glm::vec4 color,
+	FontStyle font) {
+	SceneNode node = MakeNode(SCENE_TEXT, program, 0, x, y, 0.0f, 0.0f, color);
+	node.scale = scale;
+	node.font = font;
+	node.text = text;
+	return Add(node);
+}
+
+void Scene::MarkDirty(SceneNodeId id) {
+	dirty[id] = 1;
+	anyDirty = true;
+}
+
+void Scene::SetColor(SceneNodeId id, glm::vec4 color) {
+	if (nodes[id].color == color) return;
+	nodes[id].color = color;
+	MarkDirty(id);
+}
+
+void Scene::SetText(SceneNodeId id, StringRef text) {
+	if (StringRef(nodes[id].text) == text) return;
+	nodes[id].text.assign(text.data, text.size);
+	MarkDirty(id);
+}
+
+void Scene::SetFont(SceneNodeId id, FontStyle font) {
+	if (nodes[id].font == font) return;
+	nodes[id].font = font;
+	MarkDirty(id);
+}
+
+void Scene::SetTexture(SceneNodeId id, unsigned int texture) {
+	if (nodes[id].texture == texture) return;
+	nodes[id].texture = texture;
+	MarkDirty(id);
+}
+
+void Scene::SetImage(SceneNodeId id, ImageHandle image) {
+	if (nodes[id].image == image) return;
+	nodes[id].image = image;
+	MarkDirty(id);
+}
+
+void Scene::ImagesChanged(const std::vector<ImageHandle>& images) {
+	if (images.empty()) return;
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (nodes[i].kind != SCENE_ATLAS_IMAGE) continue;
+		if (std::find(images.begin(), images.end(), nodes[i].image) != images.end()) MarkDirty(static_cast<SceneNodeId>(i));
+	}
+}
+
+void Scene::SetPosition(SceneNodeId id, float x, float y) {
+	if (nodes[id].x == x && nodes[id].y == y) return;
+	nodes[id].x = x;
+	nodes[id].y = y;
+	MarkDirty(id);
+}
+
+void Scene::SetVisible(SceneNodeId id, bool visible) {
+	if (nodes[id].visible == visible) return;
+	nodes[id].visible = visible;
+	MarkDirty(id);
+}
+
+void Scene::Invalidate() {
+	std::fill(dirty.begin(), dirty.end(), 1);
+	anyDirty = true;
+	invalidated = true;
+}
+
+glm::vec4 NodeBounds(const SceneNode& node) {
+	if (node.kind == SCENE_TEXT) return MeasureText(node.text, node.x, node.y, node.scale, node.font);
+	return glm::vec4(node.x, node.y, node.width, node.height);
+}
+
+void Scene::CollectDamage(DamageRegion& damage) const {
+	if (invalidated) {
+		damage.AddAll();
+		return;
+	}
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (!dirty[i]) continue;
+		damage.Add(drawnBounds[i]);
+		if (nodes[i].visible) damage.Add(NodeBounds(nodes[i]));
+	}
+}
+
+static void QueueNode(const SceneNode& node) {
+	switch (node.kind) {
+	case SCENE_RECT:
+		BatchRect(node.program, node.x, node.y, node.width, node.height, node.color);
+		break;
+	case SCENE_ROUNDED_RECT:
+		BatchRoundedRect(node.program, node.x, node.y, node.width, node.height, node.radius, node.color);
+		break;
+	case SCENE_IMAGE:
+		BatchTexturedRect(node.program, node.texture, node.x, node.y, node.width, node.height, node.uv, node.color);
+		break;
+	case SCENE_ATLAS_IMAGE: {
+		unsigned int texture;
+		glm::vec4 uv;
+		if (ResolveAtlasImage(node.image, texture, uv)) {
+			BatchTexturedRect(node.program, texture, node.x, node.y, node.width, node.height, uv, node.color);
+		}
+		break;
+	}
+	case SCENE_TEXT:
+		BatchText(node.program, node.text, node.x, node.y, node.scale, node.color, node.font);
+		break;
+	}
+}
+
+static void PaintNode(const SceneNode& node, SoftwareCanvas& canvas) {
+	switch (node.kind) {
+	case SCENE_RECT:
+		canvas.FillRect(node.x, node.y, node.width, node.height, node.color);
+		break;
+	case SCENE_ROUNDED_RECT:
+		canvas.FillRoundedRect(node.x, node.y, node.width, node.height, node.radius, node.color);
+		break;
+	case SCENE_IMAGE:
+		break;
+	case SCENE_ATLAS_IMAGE: {
+		const unsigned char* pixels;
+		glm::vec4 uv;
+		if (ResolveAtlasPixels(node.image, pixels, uv)) {
+			canvas.DrawImage(pixels, IMAGE_PAGE_SIZE, IMAGE_PAGE_SIZE, node.x, node.y, node.width, node.height, uv, node.color);
+		}
+		break;
+	}
+	case SCENE_TEXT:
+		canvas.DrawString(node.text, node.x, node.y, node.scale, node.color, node.font);
+		break;
+	}
+}
+
+void Scene::BeginRepaint() {
+	// Bounds of the nodes as they are about to be drawn; a clean node is
+	// drawn where it was last time, so only dirty ones are measured again
+	for (size_t i = 0; i < nodes.size(); i++) {
+		if (dirty[i]) drawnBounds[i] = nodes[i].visible ? NodeBounds(nodes[i]) : glm::vec4(0.0f);
+
+		// Images outside the damage stay on screen, so they count as used too
+		unsigned int texture;
+		glm::vec4 uv;
+		if (nodes[i].visible && nodes[i].kind == SCENE_ATLAS_IMAGE) ResolveAtlasImage(nodes[i].image, texture, uv);
+	}
+}
+
+void Scene::EndRepaint() {
+	std::fill(dirty.begin(), dirty.end(), 0);
+	anyDirty = false;
+	invalidated = false;
+}
+
+void Scene::Repaint(const DamageRegion& damage, glm::vec3 clearColor) {
+	TRACE_ZONE("Repaint");
+	BeginRepaint();
+	SetClearColor(clearColor.r, clearColor.g, clearColor.b, 1.0f);
+	EnableScissorTest(true);
+	for (const DamageRect& rect : damage.Rects()) {
+		SetScissor(rect.x, rect.y, rect.width, rect.height);
+		glClear(GL_COLOR_BUFFER_BIT);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (Overlaps(rect, drawnBounds[i])) QueueNode(nodes[i]);
+		}
+		FlushBatch();
+	}
+	EnableScissorTest(false);
+	EndRepaint();
+}
+
+void Scene::Repaint(const DamageRegion& damage, glm::vec3 clearColor, SoftwareCanvas& canvas) {
+	TRACE_ZONE("Repaint");
+	BeginRepaint();
+	for (const DamageRect& rect : damage.Rects()) {
+		canvas.SetClip(rect);
+		canvas.Clear(clearColor);
+		for (size_t i = 0; i < nodes.size(); i++) {
+			if (Overlaps(rect, drawnBounds[i])) PaintNode(nodes[i], canvas);
+		}
+	}
+	canvas.ResetClip();
+	EndRepaint();
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "damage.h"
+#include "fontservice.h"
+#include "imageatlas.h"
+#include "stringpool.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+class SoftwareCanvas;
+
+enum SceneNodeKind {
+	SCENE_RECT,
+	SCENE_ROUNDED_RECT,
+	SCENE_IMAGE,
+	SCENE_ATLAS_IMAGE,
+	SCENE_TEXT
+};
+
+// One retained draw item. Text is positioned at its baseline origin, like
+// BatchText; everything else by its bottom-left corner.
+struct SceneNode {
+	SceneNodeKind kind;
+	unsigned int program;
+	unsigned int texture;
+	ImageHandle image; // atlas images
+	float x, y, width, height;
+	float radius; // rounded rects
+	float scale;  // text
+	FontStyle font; // text
+	glm::vec4 uv; // images, as in BatchTexturedRect
+	glm::vec4 color;
+	std::string text;
+	bool visible;
+};
+
+typedef int SceneNodeId;
+
+// Screen box a node paints, as (x, y, width, height)
+glm::vec4 NodeBounds(const SceneNode& node);
+
+// Retained UI: nodes are added once, in paint order, and changed through the
+// setters, which mark a node dirty only when the value actually changes.
+// The main loop redraws while NeedsRedraw() is set and sleeps otherwise,
+// and repaints only the damage the changed nodes left behind.
+class Scene {
+public:
+	SceneNodeId AddRect(unsigned int program, float x, float y, float width, float height, glm::vec4 color);
+	SceneNodeId AddRoundedRect(unsigned int program, float x, float y, float width, float height, float radius, glm::vec4 color);
+	SceneNodeId AddImage(unsigned int program, unsigned int texture, float x, float y, float width, float height, glm::vec4 uv);
+	// Texture and texcoords are looked up in the image atlas at draw time
+	SceneNodeId AddAtlasImage(unsigned int program, ImageHandle image, float x, float y, float width, float height);
+	SceneNodeId AddText(unsigned int program, const std::string& text, float x, float y, float scale, glm::vec4 color,
+		FontStyle font = FONT_REGULAR);
+
+	const SceneNode& Node(SceneNodeId id) const { return nodes[id]; }
+	size_t NodeCount() const { return nodes.size(); }
+	bool IsDirty(SceneNodeId id) const { return dirty[id] != 0; }
+
+	void SetColor(SceneNodeId id, glm::vec4 color);
+	// Copies only when the text differs, into the node's existing buffer
+	void SetText(SceneNodeId id, StringRef text);
+	void SetFont(SceneNodeId id, FontStyle font);
+	void SetTexture(SceneNodeId id, unsigned int texture);
+	void SetImage(SceneNodeId id, ImageHandle image);
+	// Marks the nodes showing any of `images` dirty, e.g. once their pixels arrived
+	void ImagesChanged(const std::vector<ImageHandle>& images);
+	void SetPosition(SceneNodeId id, float x, float y);
+	void SetVisible(SceneNodeId id, bool visible);
+
+	// Everything needs repainting, e.g. after the window was exposed
+	void Invalidate();
+
+	// While at least one animation is running the loop keeps producing frames
+	void BeginAnimation() { animations++; }
+	void EndAnimation() { if (animations > 0) animations--; }
+	bool Animating() const { return animations > 0; }
+
+	bool NeedsRedraw() const { return anyDirty || animations > 0; }
+
+	// Adds the box each dirty node covered when last drawn and the box it
+	// covers now; everything after Invalidate() or before the first frame
+	void CollectDamage(DamageRegion& damage) const;
+	// Clears each damaged rect to `clearColor` and repaints the nodes that
+	// overlap it under a scissor, one batch flush per rect
+	void Repaint(const DamageRegion& damage, glm::vec3 clearColor);
+	// Same on the CPU. SCENE_IMAGE nodes name GL textures and are skipped.
+	void Repaint(const DamageRegion& damage, glm::vec3 clearColor, SoftwareCanvas& canvas);
+
+private:
+	SceneNodeId Add(const SceneNode& node);
+	void MarkDirty(SceneNodeId id);
+	void BeginRepaint();
+	void EndRepaint();
+
+	std::vector<SceneNode> nodes;
+	std::vector<unsigned char> dirty;
+	std::vector<glm::vec4> drawnBounds; // as of the last Repaint, empty if not drawn
+	bool anyDirty = false;
+	bool invalidated = true;
+	int animations = 0;
+};
@@ -0,0 +1,215 @@
+#include "searchindex.h"
+#include <algorithm>
+#include <cstring>
+
+// U+00C0 to U+00FF folded, '*' where it takes two letters and ' ' for the
+// multiplication and division signs
+static const char kLatin1[] = "aaaaaa*ceeeeiiiidnooooo ouuuuy**aaaaaa*ceeeeiiiidnooooo ouuuuy*y";
+// U+0100 to U+017F (Latin Extended-A) folded
+static const char kLatinExtendedA[] =
+	"aaaaaaccccccccddddeeeeeeeeeegggggggghhhhiiiiiiiiii**jjkkkllllllllllnnnnnnnnnoooooo**rrrrrrsssssssstttttt"
+	"uuuuuuuuuuuuwwyyyzzzzzzs";
+static_assert(sizeof(kLatin1) == 0x40 + 1, "one letter per codepoint from U+00C0");
+static_assert(sizeof(kLatinExtendedA) == 0x80 + 1, "one letter per codepoint from U+0100");
+
+// Posting list key for the first `count` bytes of a word, at most three: the
+// bytes, then the count in the top byte so "ab" and "ab\0" differ
+static uint32_t PrefixKey(const char* word, size_t count) {
+	uint32_t key = static_cast<uint32_t>(count) << 24;
+	for (size_t i = 0; i < count; i++) key |= static_cast<uint32_t>(static_cast<unsigned char>(word[i])) << (16 - 8 * i);
+	return key;
+}
+
+static void AppendSpace(std::string& folded) {
+	if (folded.back() != ' ') folded += ' ';
+}
+
+static void AppendFolded(StringRef text, std::string& folded) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text.data);
+	for (size_t i = 0; i < text.size; i++) {
+		unsigned char c = bytes[i];
+		if (c < 0x80) {
+			if (c >= 'A' && c <= 'Z') folded += static_cast<char>(c - 'A' + 'a');
+			else if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) folded += static_cast<char>(c);
+			else AppendSpace(folded);
+			continue;
+		}
+
+		unsigned char next = i + 1 < text.size ? bytes[i + 1] : 0;
+		bool continued = (next & 0xC0) == 0x80;
+		uint32_t codepoint = ((c & 0x1F) << 6) | (next & 0x3F);
+		if (continued && c >= 0xC2 && c <= 0xC5) {
+			i++;
+			if (codepoint < 0xC0) {
+				// No-break space, guillemets and the rest of Latin-1 punctuation
+				AppendSpace(folded);
+				continue;
+			}
+			char letter = codepoint < 0x100 ? kLatin1[codepoint - 0xC0] : kLatinExtendedA[codepoint - 0x100];
+			if (letter != '*') {
+				if (letter == ' ') AppendSpace(folded);
+				else folded += letter;
+			}
+			else if (codepoint == 0xC6 || codepoint == 0xE6) folded += "ae";
+			else if (codepoint == 0xDE || codepoint == 0xFE) folded += "th";
+			else if (codepoint == 0xDF) folded += "ss";
+			else if (codepoint == 0x132 || codepoint == 0x133) folded += "ij";
+			else folded += "oe";
+			continue;
+		}
+		// Combining accents, as in decomposed "é", are dropped
+		if (continued && (c == 0xCC || (c == 0xCD && next < 0xB0))) {
+			i++;
+			continue;
+		}
+		// General punctuation: typographic quotes and dashes, the ellipsis
+		if (c == 0xE2 && next == 0x80 && i + 2 < text.size) {
+			i += 2;
+			AppendSpace(folded);
+			continue;
+		}
+		folded += static_cast<char>(c);
+	}
+}
+
+void FoldText(StringRef text, std::string& folded) {
+	folded.assign(1, ' ');
+	AppendFolded(text, folded);
+	if (folded.size() > 1 && folded.back() == ' ') folded.pop_back();
+}
+
+// Calls `visit(word, length)` for each word of folded text
+template <typename Visit>
+static void ForEachWord(const std::string& folded, Visit visit) {
+	for (size_t start = 1; start < folded.size();) {
+		size_t end = folded.find(' ', start);
+		if (end == std::string::npos) end = folded.size();
+		visit(folded.data() + start, end - start);
+		start = end + 1;
+	}
+}
+
+// First position in `list` at or after `from` holding at least `document`;
+// steps double before the binary search, so skipping ahead costs the log of
+// the distance rather than of the list
+static size_t Seek(const std::vector<uint32_t>& list, size_t from, uint32_t document) {
+	size_t step = 1;
+	size_t to = from;
+	while (to < list.size() && list[to] < document) {
+		from = to + 1;
+		to += step;
+		step *= 2;
+	}
+	return std::lower_bound(list.begin() + from, list.begin() + std::min(to, list.size()), document) - list.begin();
+}
+
+void SearchIndex::AddPosting(Postings& postings, uint32_t document) {
+	// A word repeated in a document adds it once
+	if (postings.empty() || postings.back() != document) postings.push_back(document);
+}
+
+uint32_t SearchIndex::Add(std::initializer_list<StringRef> fields) {
+	scratch.assign(1, ' ');
+	for (StringRef field : fields) {
+		AppendFolded(field, scratch);
+		AppendSpace(scratch);
+	}
+
+	uint32_t document = documentCount++;
+	ForEachWord(scratch, [&](const char* word, size_t length) {
+		for (size_t count = 1; count <= std::min<size_t>(length, 3); count++) {
+			AddPosting(prefixes[PrefixKey(word, count)], document);
+		}
+		if (length <= 3) return;
+		StringRef text(word, length);
+		uint32_t id = words.Intern(text);
+		if (id == wordPostings.size()) {
+			wordPostings.emplace_back();
+			sortedWords.emplace(text.Str(), id);
+		}
+		AddPosting(wordPostings[id], document);
+	});
+	return document;
+}
+
+bool SearchIndex::Search(StringRef query, std::vector<uint32_t>& results) const {
+	results.clear();
+	std::string folded;
+	FoldText(query, folded);
+	if (folded.size() <= 1) return false;
+
+	// Each query word matches the union of one or more posting lists; a word
+	// with none matches nothing
+	struct Term {
+		std::vector<const Postings*> lists;
+		size_t size;
+	};
+	std::vector<Term> terms;
+	bool empty = false;
+	ForEachWord(folded, [&](const char* word, size_t length) {
+		Term term;
+		term.size = 0;
+		if (length <= 3) {
+			auto found = prefixes.find(PrefixKey(word, length));
+			if (found != prefixes.end()) term.lists.push_back(&found->second);
+		}
+		else {
+			std::string prefix(word, length);
+			for (auto it = sortedWords.lower_bound(prefix); it != sortedWords.end() && it->first.compare(0, length, prefix) == 0; ++it) {
+				term.lists.push_back(&wordPostings[it->second]);
+			}
+		}
+		for (const Postings* list : term.lists) term.size += list->size();
+		empty |= term.lists.empty();
+		terms.push_back(term);
+	});
+	if (empty) return true;
+
+	// Rarest word first; each later one can only narrow it down. Unions are
+	// marked in a bitmap of all documents, which is cleared again after use.
+	std::sort(terms.begin(), terms.end(), [](const Term& a, const Term& b) { return a.size < b.size; });
+	std::vector<uint64_t> marks;
+	for (size_t t = 0; t < terms.size(); t++) {
+		const Term& term = terms[t];
+		if (t > 0 && results.empty()) break;
+		if (term.lists.size() == 1) {
+			const Postings& list = *term.lists[0];
+			if (t == 0) {
+				results = list;
+				continue;
+			}
+			size_t kept = 0, at = 0;
+			for (uint32_t document : results) {
+				at = Seek(list, at, document);
+				if (at == list.size()) break;
+				if (list[at] == document) results[kept++] = document;
+			}
+			results.resize(kept);
+			continue;
+		}
+
+		if (marks.empty()) marks.assign((documentCount + 63) / 64, 0);
+		for (const Postings* list : term.lists) {
+			for (uint32_t document : *list) marks[document / 64] |= 1ull << (document % 64);
+		}
+		if (t == 0) {
+			for (size_t w = 0; w < marks.size(); w++) {
+				uint64_t bits = marks[w];
+				for (uint32_t bit = 0; bits; bit++, bits >>= 1) {
+					if (bits & 1) results.push_back(static_cast<uint32_t>(w * 64 + bit));
+				}
+			}
+		}
+		else {
+			size_t kept = 0;
+			for (uint32_t document : results) {
+				if (marks[document / 64] >> (document % 64) & 1) results[kept++] = document;
+			}
+			results.resize(kept);
+		}
+		for (const Postings* list : term.lists) {
+			for (uint32_t document : *list) marks[document / 64] = 0;
+		}
+	}
+	return true;
+}
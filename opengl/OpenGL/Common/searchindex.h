@@ -0,0 +1,47 @@
+#pragma once
+#include "stringpool.h"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Folds UTF-8 text for matching: lower case, Latin accents dropped ("Ça"
+// becomes "ca", "œ" becomes "oe"), and every run of punctuation or space
+// turned into one space. The result starts with a space and, when not empty,
+// ends with a word. Other scripts pass through unchanged.
+void FoldText(StringRef text, std::string& folded);
+
+// Word-prefix search over numbered documents, each made of a few text
+// fields. A query matches a document when every one of its words starts a
+// word of the document: "comm t" finds "Comment Vas tu?", "ment" does not.
+// Query words of up to three bytes are answered by the posting list of that
+// prefix, kept for the first one, two and three bytes of every word. Longer
+// ones look up the range of distinct words they start in a sorted
+// dictionary and take the union of those words' lists. Lists grow in
+// document order, so adding a document appends to them and intersections
+// walk them front to back.
+class SearchIndex {
+public:
+	// Indexes the next document; documents are numbered from 0 in the order added
+	uint32_t Add(std::initializer_list<StringRef> fields);
+	size_t Count() const { return documentCount; }
+
+	// Matching documents in increasing order. False, with `results` empty, when
+	// the query has no words, which callers take as no filter at all.
+	bool Search(StringRef query, std::vector<uint32_t>& results) const;
+
+private:
+	typedef std::vector<uint32_t> Postings;
+
+	static void AddPosting(Postings& postings, uint32_t document);
+
+	uint32_t documentCount = 0;
+	std::unordered_map<uint32_t, Postings> prefixes; // by the first bytes of a word, see PrefixKey()
+	StringTable words;                               // every distinct folded word
+	std::vector<Postings> wordPostings;              // by word id
+	std::map<std::string, uint32_t> sortedWords;     // word to id, for prefix ranges
+	std::string scratch;
+};
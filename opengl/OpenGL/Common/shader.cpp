@@ -0,0 +1,118 @@
+#include "shader.h"
+#include "glstate.h"
+#include <glad/glad.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+static unsigned int frameUBO = 0;
+
+int ShaderProgram::Uniform(const char* name) const {
+	std::vector<std::pair<std::string, int>>::const_iterator found = std::lower_bound(
+		uniforms.begin(), uniforms.end(), name,
+		[](const std::pair<std::string, int>& entry, const char* key) { return std::strcmp(entry.first.c_str(), key) < 0; });
+	if (found != uniforms.end() && found->first == name) return found->second;
+	return -1;
+}
+
+static unsigned int CompileShader(GLenum type, const char* source, const char* label) {
+	unsigned int shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	int success;
+	char infoLog[512];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cerr << label << " shader compilation failed:\n" << infoLog << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
+
+ShaderProgram CreateShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
+	ShaderProgram program;
+
+	unsigned int vertexShader = CompileShader(GL_VERTEX_SHADER, vertexShaderSource, "Vertex");
+	unsigned int fragmentShader = CompileShader(GL_FRAGMENT_SHADER, fragmentShaderSource, "Fragment");
+	if (vertexShader == 0 || fragmentShader == 0) {
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return program;
+	}
+
+	unsigned int id = glCreateProgram();
+	glAttachShader(id, vertexShader);
+	glAttachShader(id, fragmentShader);
+	glLinkProgram(id);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	int success;
+	char infoLog[512];
+	glGetProgramiv(id, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(id, 512, NULL, infoLog);
+		std::cerr << "Shader program linking failed:\n" << infoLog << std::endl;
+		glDeleteProgram(id);
+		return program;
+	}
+	program.ID = id;
+
+	// Resolve every active uniform up front
+	UseProgram(id);
+	int uniformCount = 0;
+	glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &uniformCount);
+	for (int i = 0; i < uniformCount; i++) {
+		char name[128];
+		GLsizei length = 0;
+		GLint size = 0;
+		GLenum type = 0;
+		glGetActiveUniform(id, static_cast<GLuint>(i), sizeof(name), &length, &size, &type, name);
+		int location = glGetUniformLocation(id, name);
+		if (location < 0) continue; // member of a uniform block
+
+		program.uniforms.push_back(std::make_pair(std::string(name, length), location));
+		if (type == GL_SAMPLER_2D) glUniform1i(location, 0);
+	}
+	std::sort(program.uniforms.begin(), program.uniforms.end());
+
+	unsigned int frameBlock = glGetUniformBlockIndex(id, "Frame");
+	if (frameBlock != GL_INVALID_INDEX) glUniformBlockBinding(id, frameBlock, FRAME_UNIFORM_BINDING);
+
+	return program;
+}
+
+void DeleteShaderProgram(ShaderProgram& program) {
+	DeleteProgram(program.ID);
+	program.ID = 0;
+	program.uniforms.clear();
+}
+
+void InitFrameUniforms() {
+	glGenBuffers(1, &frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameUniforms), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_UNIFORM_BINDING, frameUBO);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void UpdateFrameUniforms(const glm::mat4& projection, glm::vec2 screenSize, float time) {
+	FrameUniforms frame;
+	frame.projection = projection;
+	frame.screenSize = screenSize;
+	frame.time = time;
+	frame.padding = 0.0f;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameUniforms), &frame);
+	CountBufferUpload(sizeof(FrameUniforms));
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void DeleteFrameUniforms() {
+	glDeleteBuffers(1, &frameUBO);
+	frameUBO = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// Binding point of the "Frame" uniform block shared by every program
+const unsigned int FRAME_UNIFORM_BINDING = 0;
+
+// Frame-constant data, laid out to match this std140 block:
+//     layout (std140) uniform Frame {
+//         mat4 projection;
+//         vec2 screenSize;
+//         float time;
+//     };
+struct FrameUniforms {
+	glm::mat4 projection;
+	glm::vec2 screenSize;
+	float time;
+	float padding;
+};
+
+// Linked program with its uniform locations resolved once at link time
+struct ShaderProgram {
+	unsigned int ID = 0;
+	std::vector<std::pair<std::string, int>> uniforms; // sorted by name
+
+	// Location of `name`, or -1. Look locations up once and keep them;
+	// this is a search, not a GL call.
+	int Uniform(const char* name) const;
+};
+
+// Compiles and links, reporting errors on std::cerr (ID is 0 on failure).
+// Samplers are pointed at texture unit 0 and the Frame block, if the
+// program declares it, is bound to FRAME_UNIFORM_BINDING.
+ShaderProgram CreateShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+void DeleteShaderProgram(ShaderProgram& program);
+
+void InitFrameUniforms();
+// Writes the Frame block once; call at the start of every frame
+void UpdateFrameUniforms(const glm::mat4& projection, glm::vec2 screenSize, float time);
+void DeleteFrameUniforms();
@@ -0,0 +1,362 @@
+#include "softraster.h"
+#include "imageatlas.h"
+#include "scene.h"
+#include "text.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define SOFTRASTER_SSE2
+#include <emmintrin.h>
+#endif
+
+static bool softwareRendering = false;
+
+void SetSoftwareRendering(bool enabled) {
+	softwareRendering = enabled;
+}
+
+bool SoftwareRendering() {
+	return softwareRendering;
+}
+
+static unsigned char ToByte(float value) {
+	return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// round((source * alpha + target * (255 - alpha)) / 255) without a division;
+// the SIMD path computes exactly the same
+static unsigned char Mix(unsigned int source, unsigned int target, unsigned int alpha) {
+	unsigned int sum = source * alpha + target * (255 - alpha) + 128;
+	return static_cast<unsigned char>((sum + (sum >> 8)) >> 8);
+}
+
+// `count` pixels of one row set to `color` at `alpha` (0-255) over what they hold
+static void BlendSpan(unsigned char* row, int count, const unsigned char color[3], unsigned int alpha) {
+	if (alpha == 0 || count <= 0) return;
+	int i = 0;
+	if (alpha == 255) {
+		uint32_t pixel;
+		const unsigned char bytes[4] = { color[0], color[1], color[2], 255 };
+		std::memcpy(&pixel, bytes, 4);
+#ifdef SOFTRASTER_SSE2
+		__m128i fill = _mm_set1_epi32(static_cast<int>(pixel));
+		for (; i + 4 <= count; i += 4) _mm_storeu_si128(reinterpret_cast<__m128i*>(row + i * 4), fill);
+#endif
+		for (; i < count; i++) std::memcpy(row + i * 4, &pixel, 4);
+		return;
+	}
+#ifdef SOFTRASTER_SSE2
+	// Two pixels per half register, widened to 16 bits per channel. Alpha
+	// mixes 255 with 255, so it stays opaque.
+	__m128i source = _mm_setr_epi16(color[0], color[1], color[2], 255, color[0], color[1], color[2], 255);
+	__m128i weighted = _mm_add_epi16(_mm_mullo_epi16(source, _mm_set1_epi16(static_cast<short>(alpha))), _mm_set1_epi16(128));
+	__m128i inverse = _mm_set1_epi16(static_cast<short>(255 - alpha));
+	__m128i zero = _mm_setzero_si128();
+	for (; i + 4 <= count; i += 4) {
+		__m128i target = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i * 4));
+		__m128i low = _mm_add_epi16(weighted, _mm_mullo_epi16(_mm_unpacklo_epi8(target, zero), inverse));
+		__m128i high = _mm_add_epi16(weighted, _mm_mullo_epi16(_mm_unpackhi_epi8(target, zero), inverse));
+		low = _mm_srli_epi16(_mm_add_epi16(low, _mm_srli_epi16(low, 8)), 8);
+		high = _mm_srli_epi16(_mm_add_epi16(high, _mm_srli_epi16(high, 8)), 8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(row + i * 4), _mm_packus_epi16(low, high));
+	}
+#endif
+	for (; i < count; i++) {
+		unsigned char* pixel = row + i * 4;
+		for (int c = 0; c < 3; c++) pixel[c] = Mix(color[c], pixel[c], alpha);
+	}
+}
+
+// Bilinear fetch at texcoord (u, v), v = 0 on the first row, like GL_LINEAR
+// with GL_CLAMP_TO_EDGE
+static glm::vec4 Sample(const unsigned char* texels, int width, int height, float u, float v) {
+	float s = u * width - 0.5f, t = v * height - 0.5f;
+	float s0 = std::floor(s), t0 = std::floor(t);
+	float fs = s - s0, ft = t - t0;
+	int x0 = std::min(std::max(static_cast<int>(s0), 0), width - 1);
+	int x1 = std::min(std::max(static_cast<int>(s0) + 1, 0), width - 1);
+	int y0 = std::min(std::max(static_cast<int>(t0), 0), height - 1);
+	int y1 = std::min(std::max(static_cast<int>(t0) + 1, 0), height - 1);
+	const unsigned char* p00 = texels + (static_cast<size_t>(y0) * width + x0) * 4;
+	const unsigned char* p10 = texels + (static_cast<size_t>(y0) * width + x1) * 4;
+	const unsigned char* p01 = texels + (static_cast<size_t>(y1) * width + x0) * 4;
+	const unsigned char* p11 = texels + (static_cast<size_t>(y1) * width + x1) * 4;
+	glm::vec4 result;
+	for (int c = 0; c < 4; c++) {
+		float top = p00[c] + (p10[c] - p00[c]) * fs;
+		float bottom = p01[c] + (p11[c] - p01[c]) * fs;
+		result[c] = (top + (bottom - top) * ft) / 255.0f;
+	}
+	return result;
+}
+
+// Same for a single-channel texture
+static float SampleRed(const unsigned char* texels, int width, int height, float u, float v) {
+	float s = u * width - 0.5f, t = v * height - 0.5f;
+	float s0 = std::floor(s), t0 = std::floor(t);
+	float fs = s - s0, ft = t - t0;
+	int x0 = std::min(std::max(static_cast<int>(s0), 0), width - 1);
+	int x1 = std::min(std::max(static_cast<int>(s0) + 1, 0), width - 1);
+	int y0 = std::min(std::max(static_cast<int>(t0), 0), height - 1);
+	int y1 = std::min(std::max(static_cast<int>(t0) + 1, 0), height - 1);
+	float top = texels[y0 * width + x0] + (texels[y0 * width + x1] - texels[y0 * width + x0]) * fs;
+	float bottom = texels[y1 * width + x0] + (texels[y1 * width + x1] - texels[y1 * width + x0]) * fs;
+	return (top + (bottom - top) * ft) / 255.0f;
+}
+
+static float SmoothStep(float edge0, float edge1, float x) {
+	if (edge0 == edge1) return x < edge0 ? 0.0f : 1.0f;
+	float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+	return t * t * (3.0f - 2.0f * t);
+}
+
+SoftwareCanvas::SoftwareCanvas(int width, int height)
+	: width(std::max(width, 1)), height(std::max(height, 1)) {
+	pixels.assign(static_cast<size_t>(this->width) * this->height * 4, 255);
+	ResetClip();
+}
+
+void SoftwareCanvas::SetClip(const DamageRect& rect) {
+	int left = std::max(rect.x, 0), bottom = std::max(rect.y, 0);
+	int right = std::min(rect.x + rect.width, width), top = std::min(rect.y + rect.height, height);
+	clip = DamageRect{ left, bottom, std::max(right - left, 0), std::max(top - bottom, 0) };
+}
+
+void SoftwareCanvas::ResetClip() {
+	clip = DamageRect{ 0, 0, width, height };
+}
+
+bool SoftwareCanvas::PixelRange(float x0, float y0, float x1, float y1, int& left, int& bottom, int& right, int& top) const {
+	// Centers at i + 0.5 from x0 inclusive to x1 exclusive
+	left = std::max(static_cast<int>(std::ceil(x0 - 0.5f)), clip.x);
+	right = std::min(static_cast<int>(std::ceil(x1 - 0.5f)), clip.x + clip.width);
+	bottom = std::max(static_cast<int>(std::ceil(y0 - 0.5f)), clip.y);
+	top = std::min(static_cast<int>(std::ceil(y1 - 0.5f)), clip.y + clip.height);
+	return left < right && bottom < top;
+}
+
+void SoftwareCanvas::BlendPixel(int x, int y, glm::vec3 color, float alpha) {
+	unsigned int a = ToByte(alpha);
+	if (a == 0) return;
+	unsigned char* pixel = Row(y) + x * 4;
+	for (int c = 0; c < 3; c++) pixel[c] = Mix(ToByte(color[c]), pixel[c], a);
+}
+
+void SoftwareCanvas::Clear(glm::vec3 color) {
+	const unsigned char bytes[3] = { ToByte(color.r), ToByte(color.g), ToByte(color.b) };
+	for (int y = clip.y; y < clip.y + clip.height; y++) BlendSpan(Row(y) + clip.x * 4, clip.width, bytes, 255);
+}
+
+void SoftwareCanvas::FillRect(float x, float y, float w, float h, glm::vec4 color) {
+	TRACE_ZONE("Rect");
+	int left, bottom, right, top;
+	if (!PixelRange(x, y, x + w, y + h, left, bottom, right, top)) return;
+	const unsigned char bytes[3] = { ToByte(color.r), ToByte(color.g), ToByte(color.b) };
+	unsigned int alpha = ToByte(color.a);
+	for (int row = bottom; row < top; row++) BlendSpan(Row(row) + left * 4, right - left, bytes, alpha);
+}
+
+void SoftwareCanvas::FillRoundedRect(float x, float y, float w, float h, float radius, glm::vec4 color) {
+	TRACE_ZONE("RoundedRect");
+	// The shader's quad is grown by a pixel for the anti-aliased edge
+	int left, bottom, right, top;
+	if (!PixelRange(x - 1.0f, y - 1.0f, x + w + 1.0f, y + h + 1.0f, left, bottom, right, top)) return;
+	glm::vec2 half(w * 0.5f, h * 0.5f);
+	glm::vec2 center(x + half.x, y + half.y);
+	radius = std::min(radius, std::min(half.x, half.y));
+	const unsigned char bytes[3] = { ToByte(color.r), ToByte(color.g), ToByte(color.b) };
+	unsigned int alpha = ToByte(color.a);
+
+	for (int row = bottom; row < top; row++) {
+		unsigned char* line = Row(row);
+		float qy = std::abs(row + 0.5f - center.y) - half.y + radius;
+		// Runs of fully covered pixels go through the span fill
+		int run = left;
+		for (int column = left; column < right; column++) {
+			float qx = std::abs(column + 0.5f - center.x) - half.x + radius;
+			float outside = std::sqrt(std::max(qx, 0.0f) * std::max(qx, 0.0f) + std::max(qy, 0.0f) * std::max(qy, 0.0f));
+			float distance = std::min(std::max(qx, qy), 0.0f) + outside - radius;
+			float coverage = std::min(std::max(0.5f - distance, 0.0f), 1.0f);
+			if (coverage >= 1.0f) continue;
+			BlendSpan(line + run * 4, column - run, bytes, alpha);
+			run = column + 1;
+			BlendPixel(column, row, glm::vec3(color), color.a * coverage);
+		}
+		BlendSpan(line + run * 4, right - run, bytes, alpha);
+	}
+}
+
+void SoftwareCanvas::DrawImage(const unsigned char* texels, int textureWidth, int textureHeight, float x, float y,
+	float w, float h, glm::vec4 uv, glm::vec4 color) {
+	TRACE_ZONE("Texture");
+	int left, bottom, right, top;
+	if (!texels || w <= 0.0f || h <= 0.0f || !PixelRange(x, y, x + w, y + h, left, bottom, right, top)) return;
+	glm::vec2 step((uv.z - uv.x) / w, (uv.w - uv.y) / h);
+	for (int row = bottom; row < top; row++) {
+		float v = uv.y + (row + 0.5f - y) * step.y;
+		for (int column = left; column < right; column++) {
+			float u = uv.x + (column + 0.5f - x) * step.x;
+			glm::vec4 texel = Sample(texels, textureWidth, textureHeight, u, v) * color;
+			BlendPixel(column, row, glm::vec3(texel), texel.a);
+		}
+	}
+}
+
+void SoftwareCanvas::DrawString(const std::string& text, float x, float y, float scale, glm::vec4 color, FontStyle style) {
+	TRACE_ZONE("Text");
+	int atlasWidth, atlasHeight;
+	const unsigned char* atlas = GlyphAtlasPixels(atlasWidth, atlasHeight);
+	if (!atlas) return;
+	bool sdf = GlyphAtlasMode() == GLYPH_SDF;
+	const TextLayout& layout = LayoutText(text, scale, style);
+	for (const GlyphQuad& glyph : layout.quads) {
+		float x0 = x + glyph.x0, y0 = y + glyph.y0;
+		float x1 = x + glyph.x1, y1 = y + glyph.y1;
+		int left, bottom, right, top;
+		if (!PixelRange(x0, y0, x1, y1, left, bottom, right, top)) continue;
+		// Vertices carry uv.w at the bottom edge and uv.y at the top one
+		glm::vec2 step((glyph.uv.z - glyph.uv.x) / (x1 - x0), (glyph.uv.y - glyph.uv.w) / (y1 - y0));
+
+		// Distances over whole 2x2 pixel quads, so fwidth() can be taken the
+		// way the GPU takes it: from the neighbour within the quad
+		int quadLeft = left & ~1, quadBottom = bottom & ~1;
+		int columns = ((right + 1) & ~1) - quadLeft, rows = ((top + 1) & ~1) - quadBottom;
+		distances.resize(static_cast<size_t>(columns) * rows);
+		for (int row = 0; row < rows; row++) {
+			float v = glyph.uv.w + (quadBottom + row + 0.5f - y0) * step.y;
+			for (int column = 0; column < columns; column++) {
+				float u = glyph.uv.x + (quadLeft + column + 0.5f - x0) * step.x;
+				distances[row * columns + column] = SampleRed(atlas, atlasWidth, atlasHeight, u, v);
+			}
+		}
+
+		for (int row = bottom; row < top; row++) {
+			int r = row - quadBottom;
+			for (int column = left; column < right; column++) {
+				int c = column - quadLeft;
+				float distance = distances[r * columns + c];
+				float alpha = distance;
+				if (sdf) {
+					float dx = distances[r * columns + (c | 1)] - distances[r * columns + (c & ~1)];
+					float dy = distances[(r | 1) * columns + c] - distances[(r & ~1) * columns + c];
+					float smoothing = (std::abs(dx) + std::abs(dy)) * 0.7f;
+					alpha = SmoothStep(0.5f - smoothing, 0.5f + smoothing, distance);
+				}
+				BlendPixel(column, row, glm::vec3(color), color.a * alpha);
+			}
+		}
+	}
+}
+
+static uint32_t Crc32(const unsigned char* data, size_t size, uint32_t crc = 0) {
+	static uint32_t table[256];
+	if (!table[1]) {
+		for (uint32_t n = 0; n < 256; n++) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+	}
+	crc = ~crc;
+	for (size_t i = 0; i < size; i++) crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+static void AppendBigEndian(std::string& out, uint32_t value) {
+	for (int shift = 24; shift >= 0; shift -= 8) out += static_cast<char>((value >> shift) & 0xFF);
+}
+
+static void WriteChunk(std::ofstream& out, const char* type, const std::string& data) {
+	std::string chunk;
+	AppendBigEndian(chunk, static_cast<uint32_t>(data.size()));
+	chunk.append(type, 4);
+	chunk += data;
+	const unsigned char* crcData = reinterpret_cast<const unsigned char*>(chunk.data()) + 4;
+	AppendBigEndian(chunk, Crc32(crcData, chunk.size() - 4));
+	out.write(chunk.data(), chunk.size());
+}
+
+bool SavePNG(const char* path, const unsigned char* rgba, int width, int height) {
+	// Scanlines with filter type 0, then the zlib stream of stored blocks
+	std::string raw;
+	raw.reserve(static_cast<size_t>(width * 3 + 1) * height);
+	for (int y = 0; y < height; y++) {
+		raw += '\0';
+		const unsigned char* row = rgba + static_cast<size_t>(y) * width * 4;
+		for (int x = 0; x < width; x++) raw.append(reinterpret_cast<const char*>(row + x * 4), 3);
+	}
+	std::string stream("\x78\x01", 2);
+	uint32_t a = 1, b = 0;
+	for (size_t offset = 0; offset < raw.size() || offset == 0;) {
+		size_t length = std::min<size_t>(raw.size() - offset, 65535);
+		bool last = offset + length == raw.size();
+		stream += static_cast<char>(last ? 1 : 0);
+		stream += static_cast<char>(length & 0xFF);
+		stream += static_cast<char>(length >> 8);
+		stream += static_cast<char>(~length & 0xFF);
+		stream += static_cast<char>((~length >> 8) & 0xFF);
+		stream.append(raw, offset, length);
+		for (size_t i = offset; i < offset + length; i++) {
+			a = (a + static_cast<unsigned char>(raw[i])) % 65521;
+			b = (b + a) % 65521;
+		}
+		offset += length;
+		if (last) break;
+	}
+	AppendBigEndian(stream, (b << 16) | a);
+
+	std::string header;
+	AppendBigEndian(header, static_cast<uint32_t>(width));
+	AppendBigEndian(header, static_cast<uint32_t>(height));
+	header += std::string("\x08\x02\x00\x00\x00", 5); // 8 bits, RGB, deflate, adaptive filters, no interlace
+
+	std::string target = path;
+	std::string temporary = target + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out) {
+			std::cerr << "ERROR::SOFTRASTER: Failed to write " << target << std::endl;
+			return false;
+		}
+		out.write("\x89PNG\r\n\x1A\n", 8);
+		WriteChunk(out, "IHDR", header);
+		WriteChunk(out, "IDAT", stream);
+		WriteChunk(out, "IEND", std::string());
+		if (!out) {
+			out.close();
+			std::remove(temporary.c_str());
+			std::cerr << "ERROR::SOFTRASTER: Failed to write " << target << std::endl;
+			return false;
+		}
+	}
+
+	// rename() will not replace an existing file on Windows
+	std::remove(target.c_str());
+	if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		std::cerr << "ERROR::SOFTRASTER: Failed to write " << target << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool SoftwareCanvas::SavePNG(const char* path) const {
+	return ::SavePNG(path, pixels.data(), width, height);
+}
+
+bool SaveSceneFrame(Scene& scene, int width, int height, glm::vec3 clearColor, const char* path) {
+	FinishImageDecodes();
+	SoftwareCanvas canvas(width, height);
+	DamageRegion damage(width, height);
+	damage.AddAll();
+	UpdateImageAtlas();
+	scene.Repaint(damage, clearColor, canvas);
+	return canvas.SavePNG(path);
+}
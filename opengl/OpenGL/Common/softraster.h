@@ -0,0 +1,69 @@
+#pragma once
+#include "damage.h"
+#include "fontservice.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+class Scene;
+
+// Set once at startup, before the glyph and image atlases are created, to
+// run without a window or GL context: the atlases then keep their pixels in
+// memory instead of in textures and nothing issues GL calls.
+void SetSoftwareRendering(bool enabled);
+bool SoftwareRendering();
+
+// CPU stand-in for the framebuffer and the programs the apps draw with. Each
+// primitive shades the pixels whose centers it covers the way its shader
+// does, in the same screen units with y up, and blends them like
+// GL_SRC_ALPHA / GL_ONE_MINUS_SRC_ALPHA into an RGBA8 buffer, so a frame
+// comes out within a level or two of the GL one wherever edges are
+// anti-aliased and identical elsewhere. Solid spans are filled and blended
+// four pixels at a time with SSE2 where the target has it.
+class SoftwareCanvas {
+public:
+	SoftwareCanvas(int width, int height);
+
+	int Width() const { return width; }
+	int Height() const { return height; }
+	// RGBA, rows top first; alpha stays opaque
+	const unsigned char* Pixels() const { return pixels.data(); }
+
+	// Limits every primitive to `rect`, like glScissor
+	void SetClip(const DamageRect& rect);
+	void ResetClip();
+
+	void Clear(glm::vec3 color);
+	void FillRect(float x, float y, float width, float height, glm::vec4 color);
+	// Coverage from the rounded box's distance field, as the instanced shader
+	void FillRoundedRect(float x, float y, float width, float height, float radius, glm::vec4 color);
+	// `texels` are RGBA rows top first, sampled bilinearly with clamped edges;
+	// uv as BatchTexturedRect takes them, scaled by `color`
+	void DrawImage(const unsigned char* texels, int textureWidth, int textureHeight, float x, float y, float width,
+		float height, glm::vec4 uv, glm::vec4 color = glm::vec4(1.0f));
+	// Glyphs of the in-memory glyph atlas, thresholded like the SDF text
+	// shader or used as coverage, depending on the atlas mode
+	void DrawString(const std::string& text, float x, float y, float scale, glm::vec4 color, FontStyle style = FONT_REGULAR);
+
+	bool SavePNG(const char* path) const;
+
+private:
+	// Pixel range whose centers lie in [x0, x1) x [y0, y1), clipped; false if empty
+	bool PixelRange(float x0, float y0, float x1, float y1, int& left, int& bottom, int& right, int& top) const;
+	unsigned char* Row(int y) { return &pixels[static_cast<size_t>(height - 1 - y) * width * 4]; }
+	void BlendPixel(int x, int y, glm::vec3 color, float alpha);
+
+	int width, height;
+	DamageRect clip;
+	std::vector<unsigned char> pixels;
+	std::vector<float> distances; // text scratch
+};
+
+// Writes RGBA rows, top first, as an 8-bit RGB PNG through a temporary
+// file. The image data is stored without compression, which keeps the
+// writer free of a zlib dependency.
+bool SavePNG(const char* path, const unsigned char* rgba, int width, int height);
+
+// Waits for every pending image, draws all of `scene` on a canvas of
+// `width` x `height` and saves it to `path`
+bool SaveSceneFrame(Scene& scene, int width, int height, glm::vec3 clearColor, const char* path);
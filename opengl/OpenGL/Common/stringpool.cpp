@@ -0,0 +1,37 @@
+#include "stringpool.h"
+
+uint64_t HashString(StringRef text) {
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < text.size; i++) {
+		hash ^= static_cast<unsigned char>(text.data[i]);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+uint32_t StringArena::Add(StringRef text) {
+	bytes.insert(bytes.end(), text.data, text.data + text.size);
+	offsets.push_back(static_cast<uint32_t>(bytes.size()));
+	return static_cast<uint32_t>(Count() - 1);
+}
+
+void StringArena::Reserve(size_t strings, size_t byteCount) {
+	offsets.reserve(strings + 1);
+	bytes.reserve(byteCount);
+}
+
+int StringTable::Find(StringRef text) const {
+	auto range = lookup.equal_range(HashString(text));
+	for (auto it = range.first; it != range.second; ++it) {
+		if (arena.Get(it->second) == text) return static_cast<int>(it->second);
+	}
+	return -1;
+}
+
+uint32_t StringTable::Intern(StringRef text) {
+	int found = Find(text);
+	if (found >= 0) return static_cast<uint32_t>(found);
+	uint32_t index = arena.Add(text);
+	lookup.emplace(HashString(text), index);
+	return index;
+}
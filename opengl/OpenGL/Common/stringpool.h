@@ -0,0 +1,61 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Bytes owned by someone else, usually a StringArena; stands in for
+// std::string_view, which the projects' C++14 does not have. Only valid while
+// the storage it points into is not modified.
+struct StringRef {
+	const char* data;
+	size_t size;
+
+	StringRef() : data(""), size(0) {}
+	StringRef(const char* bytes, size_t length) : data(bytes), size(length) {}
+	StringRef(const char* text) : data(text), size(std::strlen(text)) {}
+	StringRef(const std::string& text) : data(text.data()), size(text.size()) {}
+
+	bool Empty() const { return size == 0; }
+	std::string Str() const { return std::string(data, size); }
+	bool operator==(StringRef other) const { return size == other.size && std::memcmp(data, other.data, size) == 0; }
+	bool operator!=(StringRef other) const { return !(*this == other); }
+};
+
+// FNV-1a over the bytes
+uint64_t HashString(StringRef text);
+
+// Append-only storage for many small strings: all bytes in one buffer and one
+// offset per string, so a loop over them reads memory front to back.
+class StringArena {
+public:
+	StringArena() : offsets(1, 0) {}
+
+	uint32_t Add(StringRef text);
+	StringRef Get(uint32_t index) const {
+		return StringRef(bytes.data() + offsets[index], offsets[index + 1] - offsets[index]);
+	}
+	size_t Count() const { return offsets.size() - 1; }
+	size_t Bytes() const { return bytes.size(); }
+	void Reserve(size_t strings, size_t byteCount);
+
+private:
+	std::vector<char> bytes;
+	std::vector<uint32_t> offsets; // start of each string, then the end of the last
+};
+
+// Arena that stores each distinct string once and hands out its index
+class StringTable {
+public:
+	uint32_t Intern(StringRef text);
+	// Index of `text`, or -1 when it was never interned
+	int Find(StringRef text) const;
+	StringRef Get(uint32_t index) const { return arena.Get(index); }
+	size_t Count() const { return arena.Count(); }
+
+private:
+	StringArena arena;
+	std::unordered_multimap<uint64_t, uint32_t> lookup; // hash to index, so keys never point into the arena
+};
@@ -0,0 +1,494 @@
+#include "text.h"
+#include "batch.h"
+#include "glstate.h"
+#include "softraster.h"
+#include "stringpool.h"
+#include "trace.h"
+#include <glad/glad.h>
+#include FT_MODULE_H
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <unordered_map>
+
+// Glyph key -> atlas slot map with open addressing and linear probing.
+// Erased keys leave tombstones so later probes keep going past them; Insert
+// rehashes once live keys and tombstones fill 3/4 of the buckets.
+class GlyphTable {
+public:
+	int Find(uint32_t key) const {
+		if (buckets.empty()) return -1;
+		size_t mask = buckets.size() - 1;
+		for (size_t i = Hash(key) & mask;; i = (i + 1) & mask) {
+			if (buckets[i].key == key) return buckets[i].slot;
+			if (buckets[i].key == kEmpty) return -1;
+		}
+	}
+
+	// `key` must not be in the table yet
+	void Insert(uint32_t key, int slot) {
+		if ((filled + 1) * 4 > buckets.size() * 3) Rehash();
+		size_t mask = buckets.size() - 1;
+		size_t i = Hash(key) & mask;
+		while (buckets[i].key != kEmpty && buckets[i].key != kTombstone) i = (i + 1) & mask;
+		if (buckets[i].key == kEmpty) filled++;
+		buckets[i].key = key;
+		buckets[i].slot = slot;
+		live++;
+	}
+
+	void Erase(uint32_t key) {
+		if (buckets.empty()) return;
+		size_t mask = buckets.size() - 1;
+		for (size_t i = Hash(key) & mask; buckets[i].key != kEmpty; i = (i + 1) & mask) {
+			if (buckets[i].key == key) {
+				buckets[i].key = kTombstone;
+				live--;
+				return;
+			}
+		}
+	}
+
+	void Clear() {
+		buckets.clear();
+		filled = live = 0;
+	}
+
+private:
+	// Neither is a valid key
+	static const uint32_t kEmpty = 0xFFFFFFFFu;
+	static const uint32_t kTombstone = 0xFFFFFFFEu;
+
+	struct Bucket {
+		uint32_t key;
+		int slot;
+	};
+
+	static size_t Hash(uint32_t key) {
+		uint32_t hash = key * 0x9E3779B1u;
+		return hash ^ (hash >> 16);
+	}
+
+	// Room for twice the live keys, dropping the tombstones
+	void Rehash() {
+		size_t capacity = 16;
+		while (capacity < (live + 1) * 2) capacity *= 2;
+		std::vector<Bucket> old;
+		old.swap(buckets);
+		buckets.assign(capacity, Bucket{ kEmpty, -1 });
+		filled = live = 0;
+		for (const Bucket& bucket : old) {
+			if (bucket.key != kEmpty && bucket.key != kTombstone) Insert(bucket.key, bucket.slot);
+		}
+	}
+
+	std::vector<Bucket> buckets; // power-of-two count
+	size_t filled = 0;           // live keys and tombstones
+	size_t live = 0;
+};
+
+// Codepoints need 21 bits; the style goes above them
+static uint32_t GlyphKey(FontStyle style, uint32_t codepoint) {
+	return (static_cast<uint32_t>(style) << 21) | codepoint;
+}
+
+struct GlyphSlot {
+	bool used;
+	uint32_t key;
+	Character character;
+	unsigned int lastUsed; // useStamp of the last layout that needed it
+};
+
+static GlyphMode glyphMode = GLYPH_COVERAGE;
+static int glyphPixelSize = 0; // size glyphs are rendered at
+static unsigned int atlasTexture = 0;
+static int atlasWidth = 0, atlasHeight = 0;
+static int slotWidth = 0, slotHeight = 0, slotsPerRow = 0;
+static std::vector<GlyphSlot> slots;
+static GlyphTable glyphTable;
+static std::vector<unsigned char> slotPixels; // upload scratch, one slot
+static std::vector<unsigned char> atlasPixels; // the atlas itself when rendering in software
+// Bumped by every LayoutText call; glyphs carrying the current stamp belong
+// to the string being laid out and are never evicted for it
+static unsigned int useStamp = 1;
+// Bumped on every eviction, so cached layouts know their UVs may be stale
+static unsigned int atlasGeneration = 0;
+// Bumped whenever the atlas is set up or deleted, so layouts of an older atlas never match
+static unsigned int atlasId = 0;
+// Character metrics are in pixels of the size the glyphs were rendered at;
+// this maps them to the face size a text scale of 1 stands for
+static float metricScale = 1.0f;
+
+// Lookups key on the caller's string without copying it; the key kept in the
+// index points at the cached entry's own copy instead
+struct LayoutKey {
+	StringRef text;
+	float scale;
+	FontStyle style;
+	unsigned int atlas;
+
+	bool operator==(const LayoutKey& other) const {
+		return scale == other.scale && style == other.style && atlas == other.atlas && text == other.text;
+	}
+};
+
+struct LayoutKeyHash {
+	size_t operator()(const LayoutKey& key) const {
+		size_t hash = static_cast<size_t>(HashString(key.text));
+		hash ^= std::hash<float>()(key.scale) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		hash ^= std::hash<unsigned int>()(key.atlas * FONT_STYLE_COUNT + key.style) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+		return hash;
+	}
+};
+
+struct CachedLayout {
+	std::string text;
+	LayoutKey key; // key.text points at `text`
+	TextLayout layout;
+};
+
+// Most recently used at the front; the map points into the list, whose nodes
+// never move
+typedef std::list<CachedLayout> LayoutList;
+static LayoutList layouts;
+typedef std::unordered_map<LayoutKey, LayoutList::iterator, LayoutKeyHash> LayoutIndex;
+static LayoutIndex layoutIndex;
+
+static void ClearLayoutCache() {
+	layoutIndex.clear();
+	layouts.clear();
+}
+
+bool LoadGlyphAtlas(int pixelSize, GlyphMode mode, int width, int height) {
+	DeleteGlyphAtlas();
+	if (pixelSize <= 0 || width <= 0 || height <= 0) return false;
+
+	int renderSize = mode == GLYPH_SDF ? SDF_BASE_SIZE : pixelSize;
+	if (mode == GLYPH_SDF) {
+		// Outline glyphs go through "sdf", embedded bitmaps through "bsdf"
+		FT_Int spread = SDF_SPREAD;
+		FT_Property_Set(FontLibrary(), "sdf", "spread", &spread);
+		FT_Property_Set(FontLibrary(), "bsdf", "spread", &spread);
+	}
+
+	// A slot holds one advance by the ascender-to-descender height, plus the
+	// field's spread on every side and a blank texel towards the next slot.
+	// Every style of the family shares these metrics; the rare glyph reaching
+	// further is clipped.
+	FT_Size_Metrics metrics;
+	if (!GetFontMetrics(FONT_REGULAR, renderSize, metrics)) {
+		std::cerr << "ERROR::FREETYPE: Failed to load font" << std::endl;
+		return false;
+	}
+	int margin = mode == GLYPH_SDF ? 2 * SDF_SPREAD : 0;
+	int cellWidth = static_cast<int>((metrics.max_advance + 63) >> 6) + margin + 1;
+	int cellHeight = static_cast<int>((metrics.ascender - metrics.descender + 63) >> 6) + margin + 1;
+	if (width / cellWidth == 0 || height / cellHeight == 0) {
+		std::cerr << "ERROR::FREETYPE: Glyph atlas is smaller than one glyph" << std::endl;
+		return false;
+	}
+
+	glyphMode = mode;
+	glyphPixelSize = renderSize;
+	atlasWidth = width;
+	atlasHeight = height;
+	slotWidth = cellWidth;
+	slotHeight = cellHeight;
+	slotsPerRow = width / cellWidth;
+	slots.assign(static_cast<size_t>(slotsPerRow) * (height / cellHeight), GlyphSlot());
+	slotPixels.resize(static_cast<size_t>(slotWidth) * slotHeight);
+	metricScale = static_cast<float>(pixelSize) / renderSize;
+
+	// Cleared up front so filtering at a glyph's edge only ever reads zeros
+	if (SoftwareRendering()) {
+		atlasPixels.assign(static_cast<size_t>(width) * height, 0);
+		return true;
+	}
+	std::vector<unsigned char> blank(static_cast<size_t>(width) * height, 0);
+	glGenTextures(1, &atlasTexture);
+	BindTexture2D(atlasTexture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, blank.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	return true;
+}
+
+unsigned int GlyphAtlasTexture() {
+	return atlasTexture;
+}
+
+const unsigned char* GlyphAtlasPixels(int& width, int& height) {
+	width = atlasWidth;
+	height = atlasHeight;
+	return atlasPixels.empty() ? NULL : atlasPixels.data();
+}
+
+GlyphMode GlyphAtlasMode() {
+	return glyphMode;
+}
+
+void DeleteGlyphAtlas() {
+	DeleteTexture(atlasTexture);
+	atlasTexture = 0;
+	glyphPixelSize = 0;
+	glyphTable.Clear();
+	slots.clear();
+	std::vector<unsigned char>().swap(atlasPixels);
+	ClearLayoutCache();
+	atlasId++;
+}
+
+// A free slot, or the least recently used one no longer needed by the
+// current string; -1 when there is neither
+static int TakeSlot() {
+	int oldest = -1;
+	for (size_t i = 0; i < slots.size(); i++) {
+		if (!slots[i].used) return static_cast<int>(i);
+		if (slots[i].lastUsed == useStamp) continue;
+		if (oldest < 0 || slots[i].lastUsed < slots[oldest].lastUsed) oldest = static_cast<int>(i);
+	}
+	if (oldest < 0) return -1;
+
+	// Quads already queued may still sample the old glyph
+	FlushBatch();
+	glyphTable.Erase(slots[oldest].key);
+	slots[oldest].used = false;
+	atlasGeneration++;
+	return oldest;
+}
+
+static int RasterizeGlyph(FontStyle style, uint32_t codepoint) {
+	FontGlyph glyph;
+	FT_Render_Mode mode = glyphMode == GLYPH_SDF ? FT_RENDER_MODE_SDF : FT_RENDER_MODE_NORMAL;
+	if (!RenderFontGlyph(style, glyphPixelSize, codepoint, mode, glyph)) {
+		std::cerr << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+		return -1;
+	}
+
+	int slot = TakeSlot();
+	if (slot < 0) {
+		std::cerr << "ERROR::FREETYPE: No free glyph slot" << std::endl;
+		return -1;
+	}
+
+	int width = std::min(glyph.width, slotWidth - 1);
+	int rows = glyph.pixels ? std::min(glyph.rows, slotHeight - 1) : 0;
+	int x = (slot % slotsPerRow) * slotWidth;
+	int y = (slot / slotsPerRow) * slotHeight;
+
+	// The whole slot is rewritten so nothing of the glyph it held before remains
+	std::fill(slotPixels.begin(), slotPixels.end(), 0);
+	for (int row = 0; row < rows; row++) {
+		std::memcpy(&slotPixels[static_cast<size_t>(row) * slotWidth], glyph.pixels + row * glyph.pitch, width);
+	}
+	if (SoftwareRendering()) {
+		for (int row = 0; row < slotHeight; row++) {
+			unsigned char* target = &atlasPixels[static_cast<size_t>(y + row) * atlasWidth + x];
+			std::memcpy(target, &slotPixels[static_cast<size_t>(row) * slotWidth], slotWidth);
+		}
+	}
+	else {
+		BindTexture2D(atlasTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, slotWidth, slotHeight, GL_RED, GL_UNSIGNED_BYTE, slotPixels.data());
+		CountTextureUpload(slotPixels.size());
+	}
+
+	const glm::vec2 texel(1.0f / atlasWidth, 1.0f / atlasHeight);
+	GlyphSlot& entry = slots[slot];
+	entry.used = true;
+	entry.key = GlyphKey(style, codepoint);
+	entry.character = {
+		atlasTexture,
+		glm::ivec2(width, rows),
+		glm::ivec2(glyph.left, glyph.top),
+		static_cast<unsigned int>(glyph.advance),
+		glm::vec4(x * texel.x, y * texel.y, (x + width) * texel.x, (y + rows) * texel.y)
+	};
+	glyphTable.Insert(entry.key, slot);
+	return slot;
+}
+
+static int FindGlyphSlot(FontStyle style, uint32_t codepoint) {
+	if (slots.empty()) return -1;
+	int slot = glyphTable.Find(GlyphKey(style, codepoint));
+	if (slot < 0) slot = RasterizeGlyph(style, codepoint);
+	if (slot >= 0) slots[slot].lastUsed = useStamp;
+	return slot;
+}
+
+const Character* FindGlyph(uint32_t codepoint, FontStyle style) {
+	int slot = FindGlyphSlot(style, codepoint);
+	return slot < 0 ? NULL : &slots[slot].character;
+}
+
+uint32_t NextCodepoint(const std::string& text, size_t& i) {
+	static const uint32_t kReplacement = 0xFFFD;
+	unsigned char lead = static_cast<unsigned char>(text[i]);
+	if (lead < 0x80) {
+		i++;
+		return lead;
+	}
+
+	size_t length;
+	uint32_t codepoint;
+	if ((lead & 0xE0) == 0xC0) { length = 2; codepoint = lead & 0x1F; }
+	else if ((lead & 0xF0) == 0xE0) { length = 3; codepoint = lead & 0x0F; }
+	else if ((lead & 0xF8) == 0xF0) { length = 4; codepoint = lead & 0x07; }
+	else {
+		i++;
+		return kReplacement;
+	}
+	if (text.size() - i < length) {
+		i++;
+		return kReplacement;
+	}
+	for (size_t k = 1; k < length; k++) {
+		unsigned char next = static_cast<unsigned char>(text[i + k]);
+		if ((next & 0xC0) != 0x80) {
+			i++;
+			return kReplacement;
+		}
+		codepoint = (codepoint << 6) | (next & 0x3F);
+	}
+	// Overlong forms, UTF-16 surrogates and values past U+10FFFF
+	static const uint32_t kShortest[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+	if (codepoint < kShortest[length] || codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+		i++;
+		return kReplacement;
+	}
+	i += length;
+	return codepoint;
+}
+
+void AppendCodepoint(std::string& text, uint32_t codepoint) {
+	if (codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) codepoint = 0xFFFD;
+	if (codepoint < 0x80) {
+		text += static_cast<char>(codepoint);
+	}
+	else if (codepoint < 0x800) {
+		text += static_cast<char>(0xC0 | (codepoint >> 6));
+		text += static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+	else if (codepoint < 0x10000) {
+		text += static_cast<char>(0xE0 | (codepoint >> 12));
+		text += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		text += static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+	else {
+		text += static_cast<char>(0xF0 | (codepoint >> 18));
+		text += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+		text += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+		text += static_cast<char>(0x80 | (codepoint & 0x3F));
+	}
+}
+
+void EraseLastCodepoint(std::string& text) {
+	// Continuation bytes go with the lead byte before them
+	size_t end = text.size();
+	while (end > 0 && (static_cast<unsigned char>(text[end - 1]) & 0xC0) == 0x80) end--;
+	text.resize(end > 0 ? end - 1 : 0);
+}
+
+static void BuildLayout(const std::string& text, float scale, FontStyle style, TextLayout& layout) {
+	scale *= metricScale;
+	float x = 0.0f;
+	float left = 0.0f, bottom = 0.0f, right = 0.0f, top = 0.0f;
+	layout.quads.clear();
+	layout.slots.clear();
+	for (size_t i = 0; i < text.size();) {
+		size_t index = i;
+		int slot = FindGlyphSlot(style, NextCodepoint(text, i));
+		if (slot < 0) continue;
+		layout.slots.push_back(slot);
+		const Character& ch = slots[slot].character;
+
+		float xpos = x + ch.Bearing.x * scale;
+		float ypos = -(ch.Size.y - ch.Bearing.y) * scale;
+		float w = ch.Size.x * scale;
+		float h = ch.Size.y * scale;
+		// Unhinted SDF advances keep their fraction; hinted ones have none
+		x += ch.Advance / 64.0f * scale;
+		if (ch.Size.x == 0 || ch.Size.y == 0) continue;
+
+		if (layout.quads.empty()) {
+			left = xpos; bottom = ypos; right = xpos + w; top = ypos + h;
+		}
+		else {
+			left = std::min(left, xpos);
+			bottom = std::min(bottom, ypos);
+			right = std::max(right, xpos + w);
+			top = std::max(top, ypos + h);
+		}
+		GlyphQuad quad = { xpos, ypos, xpos + w, ypos + h, ch.UV, ch.TextureID, index };
+		layout.quads.push_back(quad);
+	}
+	layout.bounds = glm::vec4(left, bottom, right - left, top - bottom);
+	// Evictions made room for this layout's own glyphs, never took them
+	layout.atlasGeneration = atlasGeneration;
+}
+
+const TextLayout& LayoutText(const std::string& text, float scale, FontStyle style) {
+	useStamp++;
+	LayoutKey key = { StringRef(text), scale, style, atlasId };
+	LayoutIndex::iterator found = layoutIndex.find(key);
+	if (found != layoutIndex.end()) {
+		layouts.splice(layouts.begin(), layouts, found->second);
+		TextLayout& layout = found->second->layout;
+		if (layout.atlasGeneration != atlasGeneration) BuildLayout(text, scale, style, layout);
+		else for (int slot : layout.slots) slots[slot].lastUsed = useStamp;
+		return layout;
+	}
+
+	if (layouts.size() >= TEXT_LAYOUT_CACHE_SIZE) {
+		layoutIndex.erase(layouts.back().key);
+		layouts.pop_back();
+	}
+	layouts.emplace_front();
+	CachedLayout& cached = layouts.front();
+	cached.text = text;
+	cached.key = key;
+	cached.key.text = StringRef(cached.text);
+	layoutIndex[cached.key] = layouts.begin();
+	BuildLayout(text, scale, style, cached.layout);
+	return cached.layout;
+}
+
+static void BatchGlyphs(unsigned int program, const std::string& text, float x, float y, float scale,
+	const glm::vec4* colors, size_t colorStride, FontStyle style) {
+	TRACE_ZONE("Text");
+	const TextLayout& layout = LayoutText(text, scale, style);
+	for (const GlyphQuad& glyph : layout.quads) {
+		float x0 = x + glyph.x0, y0 = y + glyph.y0;
+		float x1 = x + glyph.x1, y1 = y + glyph.y1;
+		const glm::vec4& c = colors[glyph.index * colorStride];
+		BatchVertex quad[4] = {
+			{ x0, y0, glyph.uv.x, glyph.uv.w, c.r, c.g, c.b, c.a },
+			{ x0, y1, glyph.uv.x, glyph.uv.y, c.r, c.g, c.b, c.a },
+			{ x1, y1, glyph.uv.z, glyph.uv.y, c.r, c.g, c.b, c.a },
+			{ x1, y0, glyph.uv.z, glyph.uv.w, c.r, c.g, c.b, c.a }
+		};
+		BatchQuad(program, glyph.texture, quad);
+	}
+}
+
+void BatchText(unsigned int program, const std::string& text, float x, float y, float scale, glm::vec4 color,
+	FontStyle style) {
+	BatchGlyphs(program, text, x, y, scale, &color, 0, style);
+}
+
+void BatchText(unsigned int program, const std::string& text, float x, float y, float scale, const glm::vec4* glyphColors,
+	FontStyle style) {
+	BatchGlyphs(program, text, x, y, scale, glyphColors, 1, style);
+}
+
+glm::vec4 MeasureText(const std::string& text, float x, float y, float scale, FontStyle style) {
+	const glm::vec4& bounds = LayoutText(text, scale, style).bounds;
+	if (bounds.z == 0.0f && bounds.w == 0.0f) return glm::vec4(0.0f);
+	return glm::vec4(x + bounds.x, y + bounds.y, bounds.z, bounds.w);
+}
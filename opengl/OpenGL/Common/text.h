@@ -0,0 +1,95 @@
+#pragma once
+#include "fontservice.h"
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Structure to hold character glyph data
+struct Character {
+	unsigned int TextureID; // Atlas texture holding the glyph
+	glm::ivec2   Size;      // Size of glyph
+	glm::ivec2   Bearing;   // Offset from baseline to left/top of glyph
+	unsigned int Advance;   // Horizontal offset to advance to next glyph
+	glm::vec4    UV;        // Atlas texcoords of the bitmap's top-left (xy) and bottom-right (zw)
+};
+
+// GLYPH_COVERAGE stores the anti-aliased bitmaps FreeType renders at the
+// face's current pixel size. GLYPH_SDF stores signed distance fields rendered
+// once at SDF_BASE_SIZE, edge at 0.5 and SDF_SPREAD pixels either side of it;
+// they stay sharp at any scale and need a fragment shader that thresholds the
+// distance instead of using it as alpha.
+enum GlyphMode {
+	GLYPH_COVERAGE,
+	GLYPH_SDF
+};
+const int SDF_BASE_SIZE = 24;
+const int SDF_SPREAD = 4;
+
+// Default size of the glyph atlas texture, which is also its memory budget
+const int GLYPH_ATLAS_SIZE = 512;
+
+// Sets up an empty atlas shared by every font style; glyphs are rendered
+// through the font service the first time a string needs them. The atlas is
+// split into equal slots sized for the family, and when every slot is taken
+// the least recently used glyph makes room. In either mode a text scale of 1
+// draws at `pixelSize`. Needs InitFontService().
+bool LoadGlyphAtlas(int pixelSize, GlyphMode mode = GLYPH_COVERAGE,
+	int atlasWidth = GLYPH_ATLAS_SIZE, int atlasHeight = GLYPH_ATLAS_SIZE);
+unsigned int GlyphAtlasTexture();
+// The atlas' single-channel texels, rows top first, when software rendering
+// keeps it in memory instead of in a texture; NULL otherwise
+const unsigned char* GlyphAtlasPixels(int& width, int& height);
+GlyphMode GlyphAtlasMode();
+void DeleteGlyphAtlas();
+
+// Glyph for a Unicode codepoint in `style`, rasterized into the atlas on first use.
+// NULL without an atlas, or when the atlas has no slot to spare because every
+// glyph in it was used by the current string. The pointer stays valid until
+// the next lookup.
+const Character* FindGlyph(uint32_t codepoint, FontStyle style = FONT_REGULAR);
+
+// Decodes the UTF-8 sequence at `text[i]` and moves `i` past it. Malformed
+// bytes decode one at a time as U+FFFD.
+uint32_t NextCodepoint(const std::string& text, size_t& i);
+// Editing helpers for text typed one character at a time
+void AppendCodepoint(std::string& text, uint32_t codepoint);
+void EraseLastCodepoint(std::string& text);
+
+// One positioned glyph of a laid-out string, relative to the string's origin
+struct GlyphQuad {
+	float x0, y0, x1, y1;  // bottom-left and top-right corners
+	glm::vec4 uv;          // as in Character
+	unsigned int texture;
+	size_t index;          // first byte of the character it came from
+};
+
+// A UTF-8 string shaped at one scale with one font: its visible glyph quads
+// and the box they cover as (x, y, width, height), both relative to the origin
+struct TextLayout {
+	std::vector<GlyphQuad> quads;
+	glm::vec4 bounds;
+	std::vector<int> slots;       // atlas slot of every glyph, blanks included
+	unsigned int atlasGeneration; // atlas contents it was built against
+};
+
+// Layouts are cached by (string, scale, style) and evicted least recently used
+// first, so labels that do not change cost no glyph lookups after the first
+// draw. The reference stays valid until the next call or LoadGlyphAtlas().
+const TextLayout& LayoutText(const std::string& text, float scale, FontStyle style = FONT_REGULAR);
+const size_t TEXT_LAYOUT_CACHE_SIZE = 512;
+
+// Queues one quad per glyph into the quad batch, so every string drawn with
+// the same program shares one upload and one draw. `program` must use the
+// batch vertex layout and read glyph coverage from the atlas red channel.
+void BatchText(unsigned int program, const std::string& text, float x, float y, float scale, glm::vec4 color,
+	FontStyle style = FONT_REGULAR);
+// Same, with one color per byte of `text`; a multi-byte character takes the
+// color of its first byte
+void BatchText(unsigned int program, const std::string& text, float x, float y, float scale, const glm::vec4* glyphColors,
+	FontStyle style = FONT_REGULAR);
+
+// Box covered by the glyph quads BatchText would emit for `text`, as
+// (x, y, width, height); zero-sized when nothing would be drawn.
+glm::vec4 MeasureText(const std::string& text, float x, float y, float scale, FontStyle style = FONT_REGULAR);
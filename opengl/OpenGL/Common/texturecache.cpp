@@ -0,0 +1,151 @@
+#include "texturecache.h"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+static const char kMagic[4] = { 'O', 'G', 'T', 'C' };
+static const uint32_t kVersion = 2;
+
+struct CacheHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceSize;
+	int64_t sourceModified;
+	uint32_t width, height;
+	uint32_t cellSize, levels;
+	uint64_t pixelBytes;
+	uint32_t pathLength; // source path follows the header, padded to 16 bytes
+	uint32_t reserved;
+};
+
+static std::string cacheDirectory;
+static std::atomic<unsigned int> temporaryCounter(0);
+
+void SetTextureCacheDirectory(const char* directory) {
+	cacheDirectory = directory ? directory : "";
+	if (!cacheDirectory.empty()) MakeDirectory(cacheDirectory.c_str());
+}
+
+static size_t PaddedPathLength(size_t length) {
+	return (length + 15) & ~static_cast<size_t>(15);
+}
+
+static uint64_t HashBytes(uint64_t hash, const void* data, size_t length) {
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < length; i++) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+// Bytes of a square RGBA cell's first `levels` mip levels, largest first,
+// the way the atlas lays them out
+static uint64_t MipChainBytes(int cellSize, int levels) {
+	uint64_t bytes = 0;
+	for (int level = 0; level < levels; level++) {
+		uint64_t size = static_cast<uint64_t>(cellSize >> level);
+		bytes += size * size * 4;
+	}
+	return bytes;
+}
+
+// FNV-1a of the source path and prepared size names the container
+static std::string ContainerPath(const char* source, int width, int height) {
+	uint64_t hash = HashBytes(14695981039346656037ull, source, std::strlen(source));
+	uint32_t size[2] = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
+	hash = HashBytes(hash, size, sizeof(size));
+	char name[32];
+	std::snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(hash));
+	return cacheDirectory + "/" + name;
+}
+
+bool LoadCachedTexture(const char* source, int width, int height, int cellSize, int levels, CachedTexture& texture) {
+	if (cacheDirectory.empty()) return false;
+
+	unsigned long long sourceSize;
+	long long sourceModified;
+	if (!GetFileStamp(source, sourceSize, sourceModified)) return false;
+
+	std::unique_ptr<MappedFile> file(new MappedFile());
+	if (!file->Open(ContainerPath(source, width, height).c_str())) return false;
+	if (file->Size() < sizeof(CacheHeader)) return false;
+
+	CacheHeader header;
+	std::memcpy(&header, file->Data(), sizeof(header));
+	size_t pathLength = std::strlen(source);
+	if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion) return false;
+	if (header.sourceSize != sourceSize || header.sourceModified != sourceModified) return false;
+	if (header.width != static_cast<uint32_t>(width) || header.height != static_cast<uint32_t>(height)) return false;
+	if (header.cellSize != static_cast<uint32_t>(cellSize) || header.levels != static_cast<uint32_t>(levels)) return false;
+	if (header.pathLength != pathLength) return false;
+	// The atlas uploads every level, so the pixels must hold the whole chain
+	if (header.pixelBytes != MipChainBytes(cellSize, levels)) return false;
+
+	size_t offset = sizeof(CacheHeader) + PaddedPathLength(pathLength);
+	if (file->Size() < offset || file->Size() - offset < header.pixelBytes) return false;
+	// Two sources whose paths hash alike
+	if (std::memcmp(file->Data() + sizeof(CacheHeader), source, pathLength) != 0) return false;
+
+	texture.width = static_cast<int>(header.width);
+	texture.height = static_cast<int>(header.height);
+	texture.cellSize = cellSize;
+	texture.levels = levels;
+	texture.pixels = file->Data() + offset;
+	texture.bytes = static_cast<size_t>(header.pixelBytes);
+	texture.file = std::move(file);
+	return true;
+}
+
+bool StoreCachedTexture(const char* source, int width, int height, int cellSize, int levels,
+	const unsigned char* pixels, size_t bytes) {
+	if (cacheDirectory.empty()) return false;
+	assert(bytes == MipChainBytes(cellSize, levels));
+	if (bytes != MipChainBytes(cellSize, levels)) return false;
+
+	unsigned long long sourceSize;
+	long long sourceModified;
+	if (!GetFileStamp(source, sourceSize, sourceModified)) return false;
+
+	CacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.sourceSize = sourceSize;
+	header.sourceModified = sourceModified;
+	header.width = static_cast<uint32_t>(width);
+	header.height = static_cast<uint32_t>(height);
+	header.cellSize = static_cast<uint32_t>(cellSize);
+	header.levels = static_cast<uint32_t>(levels);
+	header.pixelBytes = bytes;
+	header.pathLength = static_cast<uint32_t>(std::strlen(source));
+
+	std::string target = ContainerPath(source, width, height);
+	std::string temporary = target + "." + std::to_string(temporaryCounter++) + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::binary | std::ios::trunc);
+		if (!out) return false;
+		static const char padding[16] = { 0 };
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(source, header.pathLength);
+		out.write(padding, PaddedPathLength(header.pathLength) - header.pathLength);
+		out.write(reinterpret_cast<const char*>(pixels), bytes);
+		if (!out) {
+			out.close();
+			std::remove(temporary.c_str());
+			return false;
+		}
+	}
+
+	// rename() will not replace an existing file on Windows
+	std::remove(target.c_str());
+	if (std::rename(temporary.c_str(), target.c_str()) != 0) {
+		std::remove(temporary.c_str());
+		return false;
+	}
+	return true;
+}
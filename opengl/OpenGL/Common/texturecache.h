@@ -0,0 +1,28 @@
+#pragma once
+#include "mappedfile.h"
+#include <cstddef>
+#include <memory>
+
+// Decoded, mipmapped images kept on disk between runs, one small container
+// per source file. An entry is valid while the source keeps the size and
+// modification time it had when the entry was written; later runs map the
+// container and hand its pixels straight to GL.
+struct CachedTexture {
+	int width, height;           // image size inside the cell, as requested
+	int cellSize, levels;
+	const unsigned char* pixels; // RGBA, every level, largest first
+	size_t bytes;
+	std::unique_ptr<MappedFile> file; // keeps `pixels` mapped
+};
+
+// Where containers live; an empty path turns the cache off. Call before any
+// worker thread reads from or writes to the cache.
+void SetTextureCacheDirectory(const char* directory);
+
+// False when there is no valid entry for `source` prepared at width x height
+// with this cell layout. Each prepared size has its own container.
+bool LoadCachedTexture(const char* source, int width, int height, int cellSize, int levels, CachedTexture& texture);
+// Written to a temporary file first, so readers never see half an entry.
+// `bytes` must cover every level of the cell, as LoadCachedTexture checks.
+bool StoreCachedTexture(const char* source, int width, int height, int cellSize, int levels,
+	const unsigned char* pixels, size_t bytes);
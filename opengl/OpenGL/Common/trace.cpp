@@ -0,0 +1,114 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Zones kept per thread; a frame of the chat screen records a few hundred
+static const uint64_t kTraceCapacity = 1 << 16;
+
+struct TraceEvent {
+	const char* name;
+	uint64_t start, end;
+};
+
+// Written only by its own thread. `written` counts every zone ever recorded
+// and is published after the slot, so a reader knows which slots are whole.
+struct ThreadTrace {
+	unsigned int thread;
+	std::atomic<uint64_t> written;
+	ThreadTrace* next;
+	TraceEvent events[kTraceCapacity];
+};
+
+std::atomic<bool> tracingEnabled(false);
+static std::atomic<uint64_t> traceOrigin(0);
+// Buffers are pushed on a thread's first zone and never freed, so a trace
+// still holds the zones of threads that have exited
+static std::atomic<ThreadTrace*> threadTraces(NULL);
+static std::atomic<unsigned int> threadCount(0);
+static thread_local ThreadTrace* threadTrace = NULL;
+
+uint64_t TraceTimestamp() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void StartTracing() {
+	traceOrigin.store(TraceTimestamp(), std::memory_order_relaxed);
+	tracingEnabled.store(true, std::memory_order_relaxed);
+}
+
+void StopTracing() {
+	tracingEnabled.store(false, std::memory_order_relaxed);
+}
+
+static ThreadTrace* RegisterThread() {
+	ThreadTrace* trace = new ThreadTrace();
+	trace->thread = threadCount.fetch_add(1, std::memory_order_relaxed);
+	trace->written.store(0, std::memory_order_relaxed);
+	trace->next = threadTraces.load(std::memory_order_relaxed);
+	while (!threadTraces.compare_exchange_weak(trace->next, trace, std::memory_order_release, std::memory_order_relaxed)) {
+	}
+	return trace;
+}
+
+void RecordTraceZone(const char* name, uint64_t start, uint64_t end) {
+	ThreadTrace* trace = threadTrace;
+	if (!trace) trace = threadTrace = RegisterThread();
+	uint64_t index = trace->written.load(std::memory_order_relaxed);
+	TraceEvent& event = trace->events[index & (kTraceCapacity - 1)];
+	event.name = name;
+	event.start = start;
+	event.end = end;
+	trace->written.store(index + 1, std::memory_order_release);
+}
+
+// Copies the zones still in `trace`, oldest first. Slots the owner reused
+// while they were being copied are dropped rather than reported torn.
+static void CopyThreadTrace(const ThreadTrace& trace, std::vector<TraceEvent>& events) {
+	uint64_t end = trace.written.load(std::memory_order_acquire);
+	uint64_t begin = end > kTraceCapacity ? end - kTraceCapacity : 0;
+	events.clear();
+	for (uint64_t i = begin; i < end; i++) events.push_back(trace.events[i & (kTraceCapacity - 1)]);
+
+	std::atomic_thread_fence(std::memory_order_acquire);
+	uint64_t after = trace.written.load(std::memory_order_relaxed);
+	// Zone `after` may be half written into the slot of `after - kTraceCapacity`
+	if (after + 1 > begin + kTraceCapacity) {
+		uint64_t overwritten = std::min(after + 1 - kTraceCapacity - begin, end - begin);
+		events.erase(events.begin(), events.begin() + static_cast<size_t>(overwritten));
+	}
+}
+
+bool WriteTrace(const char* path) {
+	std::ofstream out(path, std::ios::trunc);
+	if (!out) {
+		std::cerr << "ERROR::TRACE: Cannot write " << path << std::endl;
+		return false;
+	}
+
+	// Timestamps in microseconds from StartTracing, as the format expects
+	uint64_t origin = traceOrigin.load(std::memory_order_relaxed);
+	out << std::fixed << std::setprecision(3);
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"OpenGL\"}}";
+	std::vector<TraceEvent> events;
+	for (ThreadTrace* trace = threadTraces.load(std::memory_order_acquire); trace; trace = trace->next) {
+		CopyThreadTrace(*trace, events);
+		for (const TraceEvent& event : events) {
+			if (event.start < origin) continue;
+			out << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << trace->thread
+				<< ",\"ts\":" << (event.start - origin) / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+		}
+	}
+	out << "\n]}\n";
+	out.close();
+	if (!out) {
+		std::cerr << "ERROR::TRACE: Cannot write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
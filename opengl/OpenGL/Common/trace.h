@@ -0,0 +1,56 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Scoped zones for a Chrome trace, opened in chrome://tracing or
+// ui.perfetto.dev. TRACE_ZONE("name") at the top of a scope records when the
+// scope was entered and left on the calling thread, while tracing is on.
+// Each thread writes its zones to its own ring buffer without taking a lock,
+// keeping the most recent ones; WriteTrace collects them whenever asked.
+//
+// With tracing off a zone costs one relaxed load and a branch. Defining
+// NO_TRACE_ZONES compiles the zones out altogether.
+
+void StartTracing();
+void StopTracing();
+// Every zone recorded since the last StartTracing that is still in the ring
+// buffers, as Chrome trace JSON; false, after saying why on std::cerr, if
+// the file cannot be written
+bool WriteTrace(const char* path);
+
+extern std::atomic<bool> tracingEnabled;
+
+inline bool TracingEnabled() {
+	return tracingEnabled.load(std::memory_order_relaxed);
+}
+
+uint64_t TraceTimestamp(); // nanoseconds on the steady clock
+// `name` must outlive the trace; zones pass string literals
+void RecordTraceZone(const char* name, uint64_t start, uint64_t end);
+
+class TraceZone {
+public:
+	explicit TraceZone(const char* zoneName) : name(NULL), start(0) {
+		if (!TracingEnabled()) return;
+		name = zoneName;
+		start = TraceTimestamp();
+	}
+	~TraceZone() {
+		if (name) RecordTraceZone(name, start, TraceTimestamp());
+	}
+	TraceZone(const TraceZone&) = delete;
+	TraceZone& operator=(const TraceZone&) = delete;
+
+private:
+	const char* name; // NULL when tracing was off on entry
+	uint64_t start;
+};
+
+#ifdef NO_TRACE_ZONES
+#define TRACE_ZONE(name) ((void)0)
+#else
+#define TRACE_ZONE_JOIN2(a, b) a##b
+#define TRACE_ZONE_JOIN(a, b) TRACE_ZONE_JOIN2(a, b)
+#define TRACE_ZONE(name) TraceZone TRACE_ZONE_JOIN(traceZone, __LINE__)(name)
+#endif
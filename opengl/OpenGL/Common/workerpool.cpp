@@ -0,0 +1,50 @@
+#include "workerpool.h"
+#include <algorithm>
+
+WorkerPool::WorkerPool(unsigned int threadCount) {
+	if (threadCount == 0) {
+		unsigned int hardware = std::thread::hardware_concurrency();
+		threadCount = std::max(hardware > 1 ? hardware - 1 : 1u, 1u);
+	}
+	for (unsigned int i = 0; i < threadCount; i++) threads.push_back(std::thread(&WorkerPool::Run, this));
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	wake.notify_all();
+	for (std::thread& thread : threads) thread.join();
+}
+
+void WorkerPool::Submit(std::function<void()> job) {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	wake.notify_one();
+}
+
+size_t WorkerPool::Pending() {
+	std::lock_guard<std::mutex> lock(mutex);
+	return jobs.size() + running;
+}
+
+void WorkerPool::Run() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping) return;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+			running++;
+		}
+		job();
+		std::lock_guard<std::mutex> lock(mutex);
+		running--;
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of threads running jobs in submission order. Jobs must not
+// touch GL; hand results back to the GL thread through a queue of your own.
+class WorkerPool {
+public:
+	// 0 threads means one less than the hardware has, and at least one
+	explicit WorkerPool(unsigned int threads = 0);
+	// Lets running jobs finish and drops the ones still queued
+	~WorkerPool();
+
+	void Submit(std::function<void()> job);
+	// Jobs queued or running
+	size_t Pending();
+
+private:
+	void Run();
+
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	size_t running = 0;
+	bool stopping = false;
+};
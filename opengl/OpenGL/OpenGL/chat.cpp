@@ -4,68 +4,93 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <ft2build.h>
-#include FT_FREETYPE_H
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <map>
 #include <string>
 #include <vector>
 #include <stb_image.h>
+#include "../Common/batch.h"
+#include "../Common/benchmark.h"
+#include "../Common/damage.h"
+#include "../Common/glstate.h"
+#include "../Common/imageatlas.h"
+#include "../Common/listview.h"
+#include "../Common/messagestore.h"
+#include "../Common/scene.h"
+#include "../Common/searchindex.h"
+#include "../Common/shader.h"
+#include "../Common/softraster.h"
+#include "../Common/text.h"
+#include "../Common/texturecache.h"
+#include "../Common/trace.h"
 // Screen dimensions
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 768;
-
-// Structure to hold character glyph data
-struct Character {
-	unsigned int TextureID; // ID handle of the glyph texture
-	glm::ivec2   Size;      // Size of glyph
-	glm::ivec2   Bearing;   // Offset from baseline to left/top of glyph
-	unsigned int Advance;   // Horizontal offset to advance to next glyph
-};
-
-std::map<char, Character> Characters;
-unsigned int VAO, VBO;
+const glm::vec3 BACKGROUND_COLOR(0.05f, 0.08f, 0.12f);
 
 // Shader sources
 const char* vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+    layout (location = 1) in vec4 vertexColor;
     out vec2 TexCoords;
+    out vec4 TextColor;
 
-    uniform mat4 projection;
+    layout (std140) uniform Frame {
+        mat4 projection;
+        vec2 screenSize;
+        float time;
+    };
 
     void main()
     {
         gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
         TexCoords = vertex.zw;
+        TextColor = vertexColor;
     }
 )";
 
 const char* fragmentShaderSource = R"(
     #version 330 core
     in vec2 TexCoords;
+    in vec4 TextColor;
     out vec4 color;
 
     uniform sampler2D text;
-    uniform vec3 textColor;
 
     void main()
     {    
-        vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-        color = vec4(textColor, 1.0) * sampled;
+        // Signed distance field: 0.5 on the outline, antialiased over about
+        // one screen pixel whatever the text scale
+        float distance = texture(text, TexCoords).r;
+        float smoothing = fwidth(distance) * 0.7;
+        float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+        color = vec4(TextColor.rgb, TextColor.a * alpha);
     }
 )";
 const char* textureVertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec4 aPosTex; // xy = position, zw = texcoords
+    layout (location = 1) in vec4 aColor;
     
     out vec2 TexCoords;
-    uniform mat4 projection;
+    out vec4 Color;
+    layout (std140) uniform Frame {
+        mat4 projection;
+        vec2 screenSize;
+        float time;
+    };
     
     void main()
     {
         gl_Position = projection * vec4(aPosTex.xy, 0.0, 1.0);
         TexCoords = aPosTex.zw;
+        Color = aColor;
     }
 )";
 
@@ -74,61 +99,53 @@ const char* textureFragmentShaderSource = R"(
     out vec4 FragColor;
     
     in vec2 TexCoords;
+    in vec4 Color;
     uniform sampler2D textureDiffuse;
     
     void main()
     {
-        FragColor = texture(textureDiffuse, TexCoords);
+        FragColor = texture(textureDiffuse, TexCoords) * Color;
     }
 )";
 
-// Simple rectangle drawing shader
-const char* rectVertexShaderSource = R"(
+const char* roundedRectVertexShader = R"(
     #version 330 core
-    layout (location = 0) in vec2 aPos;
-    
-    uniform mat4 projection;
-    
-    void main()
-    {
-        gl_Position = projection * vec4(aPos, 0.0, 1.0);
-    }
-)";
+    layout (location = 0) in vec2 aCorner; // unit quad corner
+    layout (location = 1) in vec4 aRect;   // per instance: x, y, width, height
+    layout (location = 2) in vec4 aColor;
+    layout (location = 3) in float aRadius;
+
+    out vec2 vLocalPos;
+    flat out vec2 vHalfSize;
+    flat out float vRadius;
+    flat out vec4 vColor;
+
+    layout (std140) uniform Frame {
+        mat4 projection;
+        vec2 screenSize;
+        float time;
+    };
 
-const char* rectFragmentShaderSource = R"(
-    #version 330 core
-    out vec4 FragColor;
-    
-    uniform vec3 color;
-    
     void main()
     {
-        FragColor = vec4(color, 1.0);
+        // Grow the quad by a pixel so the anti-aliased edge is not clipped
+        vec2 pos = aRect.xy - 1.0 + aCorner * (aRect.zw + 2.0);
+        vHalfSize = aRect.zw * 0.5;
+        vLocalPos = pos - (aRect.xy + vHalfSize);
+        vRadius = min(aRadius, min(vHalfSize.x, vHalfSize.y));
+        vColor = aColor;
+        gl_Position = projection * vec4(pos, 0.0, 1.0);
     }
 )";
-const char* roundedRectVertexShader = R"(
-    #version 330 core
-layout(location = 0) in vec2 aPos;
-layout(location = 1) in vec2 aUV;
-
-out vec2 vUV;
-
-void main() {
-    vUV = aUV;
-    gl_Position = vec4(aPos, 0.0, 1.0);
-}
-
-)";
 
 const char* roundedRectFragmentShader = R"(
     #version 330 core
+    in vec2 vLocalPos;
+    flat in vec2 vHalfSize;
+    flat in float vRadius;
+    flat in vec4 vColor;
     out vec4 FragColor;
     
-    uniform vec2 uSize;
-    uniform vec2 uPosition;
-    uniform float uRadius;
-    uniform vec3 uColor;
-    
     float roundedBoxSDF(vec2 centerPos, vec2 size, float radius) {
         vec2 q = abs(centerPos) - size + radius;
         return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
@@ -136,316 +153,308 @@ const char* roundedRectFragmentShader = R"(
     
     void main()
     {
-        vec2 pixelCoord = gl_FragCoord.xy;
-        vec2 center = uPosition + uSize/2.0;
-        vec2 halfSize = uSize/2.0;
-        
-        float distance = roundedBoxSDF(pixelCoord - center, halfSize, uRadius);
-        
-        if (distance > 0.0) discard;
+        float distance = roundedBoxSDF(vLocalPos, vHalfSize, vRadius);
         
-        FragColor = vec4(uColor, 1.0);
-    }
-)";
-// Vertex Shader
-const char* circleImageVertexShader = R"(
-    #version 330 core
-    layout (location = 0) in vec2 aPos;
-    layout (location = 1) in vec2 aTexCoord;
-    
-    out vec2 TexCoord;
-    out vec2 FragPos;
-    
-    uniform mat4 projection;
-    uniform mat4 model;
-    
-    void main()
-    {
-        vec4 worldPos = model * vec4(aPos, 0.0, 1.0);
-        FragPos = worldPos.xy;
-        gl_Position = projection * worldPos;
-        TexCoord = aTexCoord;
+        // One pixel wide coverage ramp instead of a hard discard
+        float coverage = clamp(0.5 - distance, 0.0, 1.0);
+        FragColor = vec4(vColor.rgb, vColor.a * coverage);
     }
 )";
-
-const char* circleImageFragmentShader = R"(
-    #version 330 core
-    in vec2 TexCoord;
-    in vec2 FragPos;
-    out vec4 FragColor;
-    
-    uniform sampler2D imageTexture;
-    uniform float radius;
-    
-    void main()
-    {
-        // Calculate distance from center
-        vec2 center = vec2(0.0);
-        float dist = length(FragPos - center);
-        
-        // Discard pixels outside circle with anti-aliasing
-        float edgeSoftness = 2.0;
-        float alpha = smoothstep(radius + edgeSoftness, radius - edgeSoftness, dist);
-        
-        // Sample texture
-        vec4 texColor = texture(imageTexture, TexCoord);
-        
-        // Final color with validation
-        FragColor = vec4(texColor.rgb, texColor.a * alpha);
-        
-        // Validation checks (corrected)
-        if (isnan(FragColor.r)) {  // Added missing parenthesis
-            FragColor = vec4(1.0, 0.0, 1.0, 1.0); // Magenta for NaN values
-        }
-        if (FragColor.a < 0.01) discard;
-    }
-)";
-unsigned int CreateShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
-unsigned int CreateTextureShader() {
-	unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertex, 1, &textureVertexShaderSource, NULL);
-	glCompileShader(vertex);
-
-	unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragment, 1, &textureFragmentShaderSource, NULL);
-	glCompileShader(fragment);
-
-	unsigned int program = glCreateProgram();
-	glAttachShader(program, vertex);
-	glAttachShader(program, fragment);
-	glLinkProgram(program);
-
-	glDeleteShader(vertex);
-	glDeleteShader(fragment);
-
-	return program;
-}
 // Product structure for our mockup
 struct Product {
 	std::string name;
 	std::string price;
 	std::string seller;
-	unsigned int textureID; 
+	ImageHandle image;
 	float x, y;
 };
 
-struct Message {
-	std::string name;
-	std::string message;
-	std::string time;
-	unsigned int textureID; 
-	int order;
-};
-
 std::vector<Product> products;
-std::vector<Message> messages;
-
-unsigned int shaderProgram, rectShaderProgram;
-unsigned int textureShader;
-unsigned int LoadTexture(const char* path) {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	// Corrected function name here:
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-
-	if (data) {
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
+// Latest message of each conversation, newest first
+MessageStore messages;
+std::vector<ImageHandle> avatars; // by sender
+
+ShaderProgram shaderProgram;
+ShaderProgram textureShader;
+ShaderProgram roundedRectShader;
+
+// Everything on screen, built once and redrawn only when a node changes
+Scene scene;
+// Frames are kept offscreen so each one only repaints what changed
+bool retainFrame = false;
+DamageRegion damage(SCR_WIDTH, SCR_HEIGHT);
+// "--trace <file.json>" records zones from startup; F12 writes what is in the
+// buffers so far and the rest is written on exit
+const char* traceOutput = NULL;
+const int SELECTED_MESSAGE = 2;
+
+// The conversation list only has scene nodes for the rows that fit on
+// screen; they are rebound to whichever conversations scroll under them
+struct ConversationRow {
+	SceneNodeId highlight, avatar, time, name, preview;
+	int message; // bound conversation, -1 for none
+};
+ListView conversationList;
+std::vector<ConversationRow> conversationRows;
+int hoveredMessage = -1;
+glm::vec2 cursor(-1.0f);
+bool scrollAnimating = false;
+// Local midnight starting today and tomorrow; times from before the first
+// show as a date
+int64_t startOfDay = 0, startOfNextDay = 0;
+const float CONVERSATION_ROW_HEIGHT = 115; // a card and the gap above it
+const float CONVERSATION_CARD_HEIGHT = 100;
+const float CONVERSATION_LIST_TOP = 700;
+const float SCROLL_STEP = CONVERSATION_ROW_HEIGHT;
+// Search over sender names and message text, built on the first keystroke and
+// brought up to date with new messages before each query
+SearchIndex conversationIndex;
+std::string searchQuery;
+std::vector<uint32_t> searchResults; // conversations listed while a query is typed
+bool searching = false;
+SceneNodeId searchText;
+const glm::vec3 SEARCH_PLACEHOLDER_COLOR(0.43f, 0.47f, 0.51f);
+// Drawn sizes; images are decoded straight to these
+const int AVATAR_SIZE = 90;
+const int HEADER_IMAGE_SIZE = 60;
+SceneNodeId AddText(const ShaderProgram& shader, std::string text, float x, float y, float scale, glm::vec3 color,
+	FontStyle font = FONT_REGULAR);
+SceneNodeId AddRect(float x, float y, float width, float height, glm::vec3 color);
+SceneNodeId AddRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color);
+void AddProductCard(float x, float y, const Product& product);
+void AddConversationRows();
+void UpdateConversationRows();
+void RunSearch();
+bool UpdateDayBoundary();
+void GenerateConversations(int count, int64_t today);
+GLFWwindow* InitWindow(bool visible);
+void DrawFrame();
+void BuildScene(ImageHandle headerImage);
+void OnCursorMove(GLFWwindow* window, double x, double y);
+void OnScroll(GLFWwindow* window, double x, double y);
+void OnChar(GLFWwindow* window, unsigned int codepoint);
+void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods);
+void OnWindowRefresh(GLFWwindow* window);
+glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.0f, static_cast<float>(SCR_HEIGHT));
+#include <cmath>
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+SceneNodeId AddImage(ImageHandle image, float x, float y, float width, float height) {
+	// Atlas images share one page texture, so a whole grid batches into one draw
+	return scene.AddAtlasImage(textureShader.ID, image, x, y, width, height);
+}
+int main(int argc, char** argv) {
+	// "--software <file.png>" draws the first frame on the CPU into a PNG and
+	// exits, for machines without a GPU or a display
+	const char* softwareOutput = NULL;
+	// "--gl-stats" logs the redundant GL calls the state cache skipped
+	bool glStats = false;
+	// "--generate <count>" appends that many made-up older conversations to
+	// the sample ones, to check that the list costs the same at any length
+	int generatedConversations = 0;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--gl-stats") == 0) glStats = true;
+		else if (i + 1 >= argc) break;
+		else if (std::strcmp(argv[i], "--software") == 0) softwareOutput = argv[i + 1];
+		else if (std::strcmp(argv[i], "--trace") == 0) traceOutput = argv[i + 1];
+		else if (std::strcmp(argv[i], "--generate") == 0) generatedConversations = std::max(0, std::atoi(argv[i + 1]));
 	}
-	else {
-		std::cerr << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+	if (traceOutput) StartTracing();
+	// "--benchmark <frames>" times that many full repaints in a hidden window
+	// (or on the CPU with --software) and exits
+	BenchmarkOptions benchmark;
+	if (!ParseBenchmarkOptions(argc, argv, benchmark)) return -1;
+	SetSoftwareRendering(softwareOutput != NULL);
+	GLFWwindow* window = NULL;
+	if (!softwareOutput) {
+		window = InitWindow(benchmark.frames == 0);
+		if (!window) return -1;
 	}
 
-	return textureID;
-}
-unsigned int LoadTextureCircular(const std::string& path) {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
-
-	int width, height, nrComponents;
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrComponents, 0);
-
-	if (data) {
-		GLenum format;
-		if (nrComponents == 1) format = GL_RED;
-		else if (nrComponents == 3) format = GL_RGB;
-		else if (nrComponents == 4) format = GL_RGBA;
-
-		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
-
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		stbi_image_free(data);
-	}
-	else {
-		std::cerr << "Failed to load texture at path: " << path << std::endl;
-		stbi_image_free(data);
+	InitImageAtlas();
+	// Images decode on worker threads and wake the loop when one is ready
+	if (window) SetImageDecodedCallback(glfwPostEmptyEvent);
+	// Decoded images are kept here so later launches skip the decode
+	SetTextureCacheDirectory("C:/opengl/cache");
+
+	// Every weight of the family is opened on demand and kept cached for the
+	// whole run
+	if (!InitFontService("C:/font/IBM_Plex_Mono")) {
+		return -1;
 	}
 
-	return textureID;
-}
-void RenderCircularImage(unsigned int texture, float x, float y, float diameter) {
-	static unsigned int shaderProgram = 0;
-	static unsigned int VAO = 0;
-
-	// 1. Initialize shader and VAO
-	if (shaderProgram == 0) {
-		shaderProgram = CreateShaderProgram(circleImageVertexShader, circleImageFragmentShader);
-		if (shaderProgram == 0) {
-			std::cerr << "Failed to create shader program!" << std::endl;
-			return;
-		}
+	// Distance fields from one base size serve every text scale; glyphs are
+	// rasterized into the atlas as strings first use them
+	if (!LoadGlyphAtlas(48, GLYPH_SDF)) {
+		return -1;
+	}
 
-		float vertices[] = {
-			-0.5f, -0.5f, 0.0f, 0.0f,
-			 0.5f, -0.5f, 1.0f, 0.0f,
-			 0.5f,  0.5f, 1.0f, 1.0f,
-			-0.5f,  0.5f, 0.0f, 1.0f
-		};
-		unsigned int indices[] = { 0, 1, 2, 0, 2, 3 };
-
-		glGenVertexArrays(1, &VAO);
-		unsigned int VBO, EBO;
-		glGenBuffers(1, &VBO);
-		glGenBuffers(1, &EBO);
-
-		glBindVertexArray(VAO);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-		glEnableVertexAttribArray(0);
-		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-		glEnableVertexAttribArray(1);
+	float firstRow = 450;
+	float secondRow = 180;
+	// Create some sample products
+	UpdateDayBoundary();
+	int64_t today = startOfDay;
+	messages.Add("Amel", "Bonsoir", today + 19 * 3600 + 3 * 60);
+	messages.Add("Ahmed", "Comment Vas tu?", today + 17 * 3600 + 53 * 60);
+	messages.Add("Nour", "Super !", today + 16 * 3600 + 22 * 60);
+	messages.Add("Mourad", "Exactement ce mood que je ressens...", today + 13 * 3600 + 30 * 60);
+	messages.Add("Kais", "C'est où ça?", today + 11 * 3600 + 9 * 60);
+	messages.Add("Lina", "Bonjour", today + 7 * 3600 + 42 * 60);
+	for (int face = 1; face <= 6; face++) {
+		std::string path = "C:/opengl/images/face" + std::to_string(face) + ".png";
+		avatars.push_back(LoadAtlasImageAsync(path.c_str(), AVATAR_SIZE, AVATAR_SIZE));
+	}
+	if (generatedConversations > 0) GenerateConversations(generatedConversations, today);
+	ImageHandle image = LoadAtlasImageAsync("C:/opengl/images/face3.png", HEADER_IMAGE_SIZE, HEADER_IMAGE_SIZE);
+	BuildScene(image);
+
+	if (softwareOutput) {
+		bool saved = benchmark.frames > 0
+			? RunFrameBenchmark("chat", scene, SCR_WIDTH, SCR_HEIGHT, BACKGROUND_COLOR, benchmark, DrawFrame, softwareOutput)
+			: SaveSceneFrame(scene, SCR_WIDTH, SCR_HEIGHT, BACKGROUND_COLOR, softwareOutput);
+		ShutdownImageAtlas();
+		DeleteGlyphAtlas();
+		ShutdownFontService();
+		if (traceOutput) WriteTrace(traceOutput);
+		return saved ? 0 : -1;
 	}
 
-	// 2. Set transformations
-	glm::mat4 projection = glm::ortho(0.0f, (float)SCR_WIDTH, (float)SCR_HEIGHT, 0.0f);
-	glm::mat4 model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(x, y, 0.0f));
-	model = glm::scale(model, glm::vec3(diameter, diameter, 1.0f));
-
-	// 3. Set shader uniforms
-	glUseProgram(shaderProgram);
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, &projection[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, &model[0][0]);
-	glUniform1f(glGetUniformLocation(shaderProgram, "radius"), 0.5f);
-
-	// 4. Bind texture
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glUniform1i(glGetUniformLocation(shaderProgram, "imageTexture"), 0);
-	// 5. Draw with blending
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-	// 6. Error checking
-	GLenum err;
-	while ((err = glGetError()) != GL_NO_ERROR) {
-		std::cerr << "OpenGL error: " << err << std::endl;
+	// Without the frame copy every frame repaints the whole window
+	retainFrame = InitFrameCopy(SCR_WIDTH, SCR_HEIGHT);
+
+	if (benchmark.frames > 0) {
+		bool passed = RunFrameBenchmark("chat", scene, SCR_WIDTH, SCR_HEIGHT, BACKGROUND_COLOR, benchmark, DrawFrame);
+		ShutdownBatchRenderer();
+		ShutdownImageAtlas();
+		DeleteFrameCopy();
+		DeleteGlyphAtlas();
+		ShutdownFontService();
+		DeleteShaderProgram(shaderProgram);
+		DeleteShaderProgram(textureShader);
+		DeleteShaderProgram(roundedRectShader);
+		DeleteFrameUniforms();
+		glfwTerminate();
+		if (traceOutput) WriteTrace(traceOutput);
+		return passed ? 0 : 1;
 	}
-}
-void RenderText(unsigned int shader, std::string text, float x, float y, float scale, glm::vec3 color);
-void RenderRect(float x, float y, float width, float height, glm::vec3 color);
-void RenderRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color);
-void RenderProductCard(float x, float y, const Product& product);
-void RenderMessageCard(Message message);
-glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.0f, static_cast<float>(SCR_HEIGHT));
-#include <cmath>
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-void RenderTexture(unsigned int textureShader, unsigned int texture,
-	float x, float y, float width, float height) {
-	glUseProgram(textureShader);
-	glUniformMatrix4fv(glGetUniformLocation(textureShader, "projection"),
-		1, GL_FALSE, glm::value_ptr(projection));
-
-	float vertices[] = {
-		// positions     // texture coords (flipped vertically)
-		x, y,           0.0f, 1.0f,  // Changed from 0.0f, 0.0f
-		x, y + height,  0.0f, 0.0f,  // Changed from 0.0f, 1.0f
-		x + width, y + height, 1.0f, 0.0f,  // Changed from 1.0f, 1.0f
-		x + width, y,    1.0f, 1.0f   // Changed from 1.0f, 0.0f
-	};
 
-	unsigned int indices[] = {
-		0, 1, 2,
-		0, 2, 3
-	};
+	// Repaint on input and expose only; an idle window costs nothing
+	glfwSwapInterval(1);
+	glfwSetCursorPosCallback(window, OnCursorMove);
+	glfwSetScrollCallback(window, OnScroll);
+	glfwSetCharCallback(window, OnChar);
+	glfwSetKeyCallback(window, OnKey);
+	glfwSetWindowRefreshCallback(window, OnWindowRefresh);
 
-	unsigned int VAO, VBO, EBO;
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glGenBuffers(1, &EBO);
+	unsigned int reportedSkipped = 0;
+	double lastFrameTime = glfwGetTime();
+	// Main loop
+	std::vector<ImageHandle> uploadedImages;
+	while (!glfwWindowShouldClose(window)) {
+		// Smooth scrolling moves the list a little further every frame
+		double now = glfwGetTime();
+		if (scrollAnimating) {
+			bool moving = conversationList.Step(now - lastFrameTime);
+			UpdateConversationRows();
+			if (!moving) {
+				scrollAnimating = false;
+				scene.EndAnimation();
+			}
+		}
+		lastFrameTime = now;
 
-	glBindVertexArray(VAO);
+		// Past midnight, the day that just ended is shown as a date
+		if (UpdateDayBoundary()) {
+			for (ConversationRow& row : conversationRows) row.message = -1;
+			UpdateConversationRows();
+		}
 
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		// Finished decodes reach the atlas a few milliseconds' worth per frame
+		uploadedImages.clear();
+		UploadDecodedImages(IMAGE_UPLOAD_BUDGET_MS, uploadedImages);
+		scene.ImagesChanged(uploadedImages);
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		if (scene.NeedsRedraw()) {
+			DrawFrame();
 
-	// Position attribute
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
+			// Redundant GL calls the state cache skipped, logged whenever the figure changes
+			GLStateCounters stateCounters = EndGLStateFrame();
+			if (glStats && stateCounters.Skipped() != reportedSkipped) {
+				reportedSkipped = stateCounters.Skipped();
+				PrintGLStateCounters(stateCounters);
+			}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
+			TRACE_ZONE("SwapBuffers");
+			glfwSwapBuffers(window);
+		}
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+		// Sleep until something happens unless an animation or an upload needs the next frame
+		if (scene.Animating() || ImageUploadsPending()) {
+			TRACE_ZONE("PollEvents");
+			glfwPollEvents();
+		}
+		else {
+			// Wakes at midnight at the latest, for the date change
+			TRACE_ZONE("WaitEvents");
+			glfwWaitEventsTimeout(std::max(1.0, static_cast<double>(startOfNextDay - time(NULL))));
+		}
+	}
 
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteBuffers(1, &EBO);
+	// Clean up
+	ShutdownBatchRenderer();
+	ShutdownImageAtlas();
+	DeleteFrameCopy();
+	DeleteGlyphAtlas();
+	ShutdownFontService();
+	DeleteShaderProgram(shaderProgram);
+	DeleteShaderProgram(textureShader);
+	DeleteShaderProgram(roundedRectShader);
+	DeleteFrameUniforms();
+
+	glfwTerminate();
+	if (traceOutput) WriteTrace(traceOutput);
+	return 0;
+}
+// Repaints what changed since the last frame into the retained frame and
+// puts it on the back buffer
+void DrawFrame() {
+	TRACE_ZONE("DrawFrame");
+	UpdateFrameUniforms(projection, glm::vec2(SCR_WIDTH, SCR_HEIGHT), static_cast<float>(glfwGetTime()));
+
+	// Repaint only the damaged parts of the retained frame
+	damage.Clear();
+	if (retainFrame) scene.CollectDamage(damage);
+	else damage.AddAll();
+	damage.Merge();
+	UpdateImageAtlas();
+	BindFrameCopy();
+	scene.Repaint(damage, BACKGROUND_COLOR);
+	PresentFrameCopy();
 }
-int main() {
+// Window, context and everything drawn through GL, for the windowed run;
+// benchmarks draw into a hidden one
+GLFWwindow* InitWindow(bool visible) {
 	// Initialize GLFW
 	if (!glfwInit()) {
 		std::cerr << "Failed to initialize GLFW" << std::endl;
-		return -1;
+		return NULL;
 	}
 
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+#ifdef _DEBUG
+	glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
 	// Create window
 	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Chat messages", NULL, NULL);
 	if (!window) {
 		std::cerr << "Failed to create GLFW window" << std::endl;
 		glfwTerminate();
-		return -1;
+		return NULL;
 	}
 
 	glfwMakeContextCurrent(window);
@@ -453,461 +462,277 @@ int main() {
 	// Initialize GLAD
 	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
 		std::cerr << "Failed to initialize GLAD" << std::endl;
-		return -1;
+		return NULL;
 	}
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	ResetGLStateCache();
+	InstallGLDebugOutput();
+	EnableBlend(true);
+	SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	// Set viewport
 	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
 
-	// Compile and setup the text shader
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-
-	shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-
-	// Compile rectangle shader
-	vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &rectVertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-
-	fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &rectFragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
-
-	rectShaderProgram = glCreateProgram();
-	glAttachShader(rectShaderProgram, vertexShader);
-	glAttachShader(rectShaderProgram, fragmentShader);
-	glLinkProgram(rectShaderProgram);
-	textureShader = CreateTextureShader();
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-
-	// Configure VAO/VBO for texture quads
-	glGenVertexArrays(1, &VAO);
-	glGenBuffers(1, &VBO);
-	glBindVertexArray(VAO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
-	// FreeType initialization
-	FT_Library ft;
-	if (FT_Init_FreeType(&ft)) {
-		std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-		return -1;
-	}
+	// Projection and other per-frame constants live in one shared uniform block
+	InitFrameUniforms();
 
-	FT_Face face;
-	if (FT_New_Face(ft, "C:/font/IBM_Plex_Mono/IBMPlexMono-Regular.ttf", 0, &face)) {
-		std::cerr << "ERROR::FREETYPE: Failed to load font" << std::endl;
-		return -1;
-	}
+	// Compile and setup the text shader
+	shaderProgram = CreateShaderProgram(vertexShaderSource, fragmentShaderSource);
 
-	FT_Set_Pixel_Sizes(face, 0, 48);
+	// Rects and images share the texture shader through the quad batch
+	textureShader = CreateShaderProgram(textureVertexShaderSource, textureFragmentShaderSource);
+	roundedRectShader = CreateShaderProgram(roundedRectVertexShader, roundedRectFragmentShader);
+	InitBatchRenderer();
 
 	// Disable byte-alignment restriction
 	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	return window;
+}
 
-	// Load first 128 characters of ASCII set
-	for (unsigned char c = 0; c < 128; c++) {
-		if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-			std::cerr << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-			continue;
-		}
+void BuildScene(ImageHandle headerImage) {
+	AddRect(0, 0, SCR_WIDTH / 2.5, SCR_HEIGHT, glm::vec3(0.09f, 0.13f, 0.17f));
 
-		// Generate texture
-		unsigned int texture;
-		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
-		glTexImage2D(
-			GL_TEXTURE_2D,
-			0,
-			GL_RED,
-			face->glyph->bitmap.width,
-			face->glyph->bitmap.rows,
-			0,
-			GL_RED,
-			GL_UNSIGNED_BYTE,
-			face->glyph->bitmap.buffer
-		);
-
-		// Set texture options
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-		// Store character for later use
-		Character character = {
-			texture,
-			glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-			glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-			static_cast<unsigned int>(face->glyph->advance.x)
-		};
-		Characters.insert(std::pair<char, Character>(c, character));
-	}
+	// Conversation list; rows scrolled past its top slide under the search bar,
+	// which is painted over them
+	conversationList.SetViewport(glm::vec4(0, 0, SCR_WIDTH / 2.5, CONVERSATION_LIST_TOP));
+	conversationList.AddRows(messages.Count(), CONVERSATION_ROW_HEIGHT);
+	AddConversationRows();
+	UpdateConversationRows();
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	AddRect(0, CONVERSATION_LIST_TOP, SCR_WIDTH / 2.5, SCR_HEIGHT - CONVERSATION_LIST_TOP, glm::vec3(0.09f, 0.13f, 0.17f));
+	AddRoundedRect(10.0f, SCR_HEIGHT - 70, (SCR_WIDTH / 2.5) - 20, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
+	searchText = AddText(shaderProgram, "Recherche...", 20, SCR_HEIGHT - 55, 0.45f, SEARCH_PLACEHOLDER_COLOR);
 
-	// Clean up FreeType
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
+	//header
+	AddRect(SCR_WIDTH / 2.5, SCR_HEIGHT - 90, SCR_WIDTH - (SCR_WIDTH / 2.5), 90, glm::vec3(0.09f, 0.13f, 0.17f));
+	AddImage(headerImage, SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 80, HEADER_IMAGE_SIZE, HEADER_IMAGE_SIZE);
+	AddText(shaderProgram, "Nour", SCR_WIDTH / 2.5 + 100, SCR_HEIGHT - 60, 0.6, glm::vec3(1, 1, 1), FONT_SEMI_BOLD);
+	
 
-	// Projection matrix (for converting to screen coordinates)
 
-	glUseProgram(shaderProgram);
-	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+	//send message
+	AddRect(SCR_WIDTH / 2.5, 0, SCR_WIDTH - (SCR_WIDTH / 2.5), 90, glm::vec3(0.09f, 0.13f, 0.17f));
+	AddRoundedRect(SCR_WIDTH / 2.5 + 10, 20, SCR_WIDTH - (SCR_WIDTH / 2.5) - 120, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
+	AddRoundedRect(SCR_WIDTH - 100, 20, 90, 50.0f, 15.0f, glm::vec3(0.169, 0.322, 0.471));
+	AddText(shaderProgram, "Envoyer", SCR_WIDTH - 95, 37, 0.4, glm::vec3(1, 1, 1));
+	AddText(shaderProgram, "Tapez un message...", SCR_WIDTH / 2.5 + 20, 37, 0.4, glm::vec3(0.43f, 0.47f, 0.51f));
+	//messages
+	AddRoundedRect(SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 150, 110, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
+	AddText(shaderProgram, "Bonjour", SCR_WIDTH / 2.5 + 30, SCR_HEIGHT - 133, 0.4, glm::vec3(1, 1, 1));
 
-	glUseProgram(rectShaderProgram);
-	glUniformMatrix4fv(glGetUniformLocation(rectShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-	float firstRow = 450;
-	float secondRow = 180;
-	// Create some sample products
-	messages.push_back({ "Amel", "Bonsoir", "19:03",LoadTexture("C:/opengl/images/face1.png"), 6 });
-	messages.push_back({ "Ahmed", "Comment Vas tu?", "17:53",LoadTexture("C:/opengl/images/face2.png"), 5 });
-	messages.push_back({ "Nour", "Super !", "16:22",LoadTexture("C:/opengl/images/face3.png"), 4 });
-	messages.push_back({ "Mourad", "Exactement ce mood que je ressens...", "13:30",LoadTexture("C:/opengl/images/face4.png"), 3 });
-	messages.push_back({ "Kais", "C'est ou ca?", "11:09",LoadTexture("C:/opengl/images/face5.png"), 2 });
-	messages.push_back({ "Lina", "Bonjour", "07:42",LoadTexture("C:/opengl/images/face6.png"), 1 });
-	unsigned int image = LoadTexture("C:/opengl/images/face3.png");
-	// Main loop
-	while (!glfwWindowShouldClose(window)) {
-		// Clear screen
-		glClearColor(0.05f, 0.08f, 0.12f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-		RenderRect(0, 0, SCR_WIDTH / 2.5, SCR_HEIGHT, glm::vec3(0.09f, 0.13f, 0.17f));
-		
-		RenderRoundedRect(10.0f, SCR_HEIGHT - 70, (SCR_WIDTH / 2.5) - 20, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
-		RenderText(shaderProgram, "Recherche...", 20, SCR_HEIGHT - 55, 0.45f, glm::vec3(0.43f, 0.47f, 0.51f));
-		
-		// Render all products
-		for (const auto& message : messages) {
-		    RenderMessageCard(message);
-		}
-		//header
-		RenderRect(SCR_WIDTH / 2.5, SCR_HEIGHT - 90, SCR_WIDTH - (SCR_WIDTH / 2.5), 90, glm::vec3(0.09f, 0.13f, 0.17f));
-		RenderTexture(textureShader, image, SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 80, 60, 60);
-		RenderText(shaderProgram, "Nour", SCR_WIDTH / 2.5 + 100, SCR_HEIGHT - 60, 0.6, glm::vec3(1, 1, 1));
-		
-
-
-		//send message
-		RenderRect(SCR_WIDTH / 2.5, 0, SCR_WIDTH - (SCR_WIDTH / 2.5), 90, glm::vec3(0.09f, 0.13f, 0.17f));
-		RenderRoundedRect(SCR_WIDTH / 2.5 + 10, 20, SCR_WIDTH - (SCR_WIDTH / 2.5) - 120, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
-		RenderRoundedRect(SCR_WIDTH - 100, 20, 90, 50.0f, 15.0f, glm::vec3(0.169, 0.322, 0.471));
-		RenderText(shaderProgram, "Envoyer", SCR_WIDTH - 95, 37, 0.4, glm::vec3(1, 1, 1));
-		RenderText(shaderProgram, "Tapez un message...", SCR_WIDTH / 2.5 + 20, 37, 0.4, glm::vec3(0.43f, 0.47f, 0.51f));
-		//messages
-		RenderRoundedRect(SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 150, 110, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
-		RenderText(shaderProgram, "Bonjour", SCR_WIDTH / 2.5 + 30, SCR_HEIGHT - 133, 0.4, glm::vec3(1, 1, 1));
-
-		RenderRoundedRect(SCR_WIDTH - 120, SCR_HEIGHT - 220, 110, 50.0f, 15.0f, glm::vec3(0.169, 0.322, 0.471));
-		RenderText(shaderProgram, "Bonjour", SCR_WIDTH - 110, SCR_HEIGHT - 203, 0.4, glm::vec3(1, 1, 1));
-
-		RenderRoundedRect(SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 290, 110, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
-		RenderText(shaderProgram, "Ca va?", SCR_WIDTH / 2.5 + 30, SCR_HEIGHT - 273, 0.4, glm::vec3(1, 1, 1));
-
-		RenderRoundedRect(SCR_WIDTH - 180, SCR_HEIGHT - 360, 170, 50.0f, 15.0f, glm::vec3(0.169, 0.322, 0.471));
-		RenderText(shaderProgram, "Ca va et toi?", SCR_WIDTH - 170, SCR_HEIGHT - 343, 0.4, glm::vec3(1, 1, 1));
-
-		RenderRoundedRect(SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 430, 110, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
-		RenderText(shaderProgram, "Super !", SCR_WIDTH / 2.5 + 30, SCR_HEIGHT - 413, 0.4, glm::vec3(1, 1, 1));
-		// Swap buffers and poll events
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
+	AddRoundedRect(SCR_WIDTH - 120, SCR_HEIGHT - 220, 110, 50.0f, 15.0f, glm::vec3(0.169, 0.322, 0.471));
+	AddText(shaderProgram, "Bonjour", SCR_WIDTH - 110, SCR_HEIGHT - 203, 0.4, glm::vec3(1, 1, 1));
 
-	// Clean up
-	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &VBO);
-	glDeleteProgram(shaderProgram);
-	glDeleteProgram(rectShaderProgram);
+	AddRoundedRect(SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 290, 110, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
+	AddText(shaderProgram, "Ça va?", SCR_WIDTH / 2.5 + 30, SCR_HEIGHT - 273, 0.4, glm::vec3(1, 1, 1));
 
-	glfwTerminate();
-	return 0;
-}
-void RenderTexture(unsigned int texture, float x, float y, float width, float height) {
-	glUseProgram(rectShaderProgram);
-	glUniform3f(glGetUniformLocation(rectShaderProgram, "color"), 1.0f, 1.0f, 1.0f);
-
-	float vertices[] = {
-		x, y, 0.0f, 0.0f,
-		x, y + height, 0.0f, 1.0f,
-		x + width, y + height, 1.0f, 1.0f,
-		x + width, y, 1.0f, 0.0f
-	};
+	AddRoundedRect(SCR_WIDTH - 180, SCR_HEIGHT - 360, 170, 50.0f, 15.0f, glm::vec3(0.169, 0.322, 0.471));
+	AddText(shaderProgram, "Ça va et toi?", SCR_WIDTH - 170, SCR_HEIGHT - 343, 0.4, glm::vec3(1, 1, 1));
 
-	unsigned int indices[] = {
-		0, 1, 2,
-		0, 2, 3
-	};
-
-	unsigned int texVAO, texVBO, texEBO;
-	glGenVertexArrays(1, &texVAO);
-	glGenBuffers(1, &texVBO);
-	glGenBuffers(1, &texEBO);
-
-	glBindVertexArray(texVAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, texVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, texEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	AddRoundedRect(SCR_WIDTH / 2.5 + 20, SCR_HEIGHT - 430, 110, 50.0f, 15.0f, glm::vec3(0.14f, 0.18f, 0.24f));
+	AddText(shaderProgram, "Super !", SCR_WIDTH / 2.5 + 30, SCR_HEIGHT - 413, 0.4, glm::vec3(1, 1, 1));
+}
 
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
 
-	glDeleteVertexArrays(1, &texVAO);
-	glDeleteBuffers(1, &texVBO);
-	glDeleteBuffers(1, &texEBO);
+// Moves startOfDay and startOfNextDay on once midnight has passed, which the
+// first call always counts as; true when they changed
+bool UpdateDayBoundary() {
+	time_t now = time(NULL);
+	if (now < startOfNextDay) return false;
+	tm local = *localtime(&now);
+	local.tm_hour = local.tm_min = local.tm_sec = 0;
+	local.tm_isdst = -1;
+	startOfDay = static_cast<int64_t>(mktime(&local));
+	// mktime normalizes the day after the last of the month, and finds that
+	// day's own DST offset
+	local.tm_mday++;
+	local.tm_hour = 0;
+	local.tm_isdst = -1;
+	startOfNextDay = static_cast<int64_t>(mktime(&local));
+	return true;
 }
 
-void RenderMessageCard(Message message) {
-	if (message.order == 4) {
-		RenderRect(0, 585 - ((6 - message.order) * 115), SCR_WIDTH / 2.5, 100, glm::vec3(0.169, 0.322, 0.471));
-	}
-	RenderTexture(textureShader, message.textureID,
-		10, 590 - ((6 - message.order) * 115), 90, 90);
-	RenderText(shaderProgram, message.time, 435, 650 - ((6 - message.order) * 115), 0.25, glm::vec3(0.43f, 0.47f, 0.51f));
-	RenderText(shaderProgram, message.name, 115, 650 - ((6 - message.order) * 115), 0.4, glm::vec3(1, 1, 1));
-	RenderText(shaderProgram, message.message, 115, 615 - ((6 - message.order) * 115), 0.35, glm::vec3(0.43f, 0.47f, 0.51f));
-}
-void RenderText(unsigned int shader, std::string text, float x, float y, float scale, glm::vec3 color) {
-	// Activate corresponding render state
-	glUseProgram(shader);
-	glUniform3f(glGetUniformLocation(shader, "textColor"), color.x, color.y, color.z);
-	glActiveTexture(GL_TEXTURE0);
-	glBindVertexArray(VAO);
-
-	// Iterate through all characters
-	std::string::const_iterator c;
-	for (c = text.begin(); c != text.end(); c++) {
-		Character ch = Characters[*c];
-
-		float xpos = x + ch.Bearing.x * scale;
-		float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
-
-		float w = ch.Size.x * scale;
-		float h = ch.Size.y * scale;
-
-		// Update VBO for each character
-		float vertices[6][4] = {
-			{ xpos,     ypos + h,   0.0f, 0.0f },
-			{ xpos,     ypos,       0.0f, 1.0f },
-			{ xpos + w, ypos,       1.0f, 1.0f },
-
-			{ xpos,     ypos + h,   0.0f, 0.0f },
-			{ xpos + w, ypos,       1.0f, 1.0f },
-			{ xpos + w, ypos + h,   1.0f, 0.0f }
-		};
-
-		// Render glyph texture over quad
-		glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-		glBindBuffer(GL_ARRAY_BUFFER, 0);
-		glDrawArrays(GL_TRIANGLES, 0, 6);
-
-		// Now advance cursors for next glyph
-		x += (ch.Advance >> 6) * scale;
-	}
-	glBindVertexArray(0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+// Time of day for today's messages, day and month for older ones
+size_t FormatMessageTime(int64_t timestamp, char* out, size_t size) {
+	time_t seconds = static_cast<time_t>(timestamp);
+	return strftime(out, size, timestamp >= startOfDay ? "%H:%M" : "%d/%m", localtime(&seconds));
 }
 
-void RenderRect(float x, float y, float width, float height, glm::vec3 color) {
-	glUseProgram(rectShaderProgram);
-	glUniform3f(glGetUniformLocation(rectShaderProgram, "color"), color.x, color.y, color.z);
-
-	float vertices[] = {
-		x, y,
-		x, y + height,
-		x + width, y + height,
-		x + width, y
-	};
-
-	unsigned int indices[] = {
-		0, 1, 2,
-		0, 2, 3
+void GenerateConversations(int count, int64_t today) {
+	static const char* const names[] = { "Sami", "Yasmine", "Omar", "Ines", "Walid", "Salma", "Karim", "Rania" };
+	static const char* const previews[] = {
+		"On se voit demain?", "Merci beaucoup !", "D'accord, à plus tard", "Tu as vu le match?",
+		"J'arrive dans 10 minutes", "Bonne nuit", "Photo envoyée", "Ça marche"
 	};
+	messages.Reserve(messages.Count() + count, messages.Bodies().Bytes() + count * 16);
+	size_t faces = avatars.size();
+	for (int i = 0; i < count; i++) {
+		// A few hundred contacts, oldest conversation last, a few dozen per day
+		char name[32];
+		snprintf(name, sizeof(name), "%s %c.", names[i % 8], 'A' + (i / 8) % 26);
+		int64_t timestamp = today - (1 + i / 40) * 86400 + (i * 7919) % 86400;
+		size_t message = messages.Add(name, previews[(i * 3) % 8], timestamp);
+		// New contacts borrow one of the sample faces
+		SenderId sender = messages[message].sender;
+		if (sender >= avatars.size()) avatars.push_back(avatars[sender % faces]);
+	}
+}
 
-	unsigned int rectVAO, rectVBO, rectEBO;
-	glGenVertexArrays(1, &rectVAO);
-	glGenBuffers(1, &rectVBO);
-	glGenBuffers(1, &rectEBO);
-
-	glBindVertexArray(rectVAO);
-
-	glBindBuffer(GL_ARRAY_BUFFER, rectVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rectEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-	glDeleteVertexArrays(1, &rectVAO);
-	glDeleteBuffers(1, &rectVBO);
-	glDeleteBuffers(1, &rectEBO);
+void AddConversationRows() {
+	// Enough rows to cover the viewport with one cut at each edge
+	glm::vec4 viewport = conversationList.Viewport();
+	size_t count = static_cast<size_t>(std::ceil(viewport.w / CONVERSATION_ROW_HEIGHT)) + 1;
+	conversationRows.resize(count);
+	for (ConversationRow& row : conversationRows) {
+		row.highlight = AddRect(0, 0, viewport.z, CONVERSATION_CARD_HEIGHT, glm::vec3(0.12f, 0.17f, 0.22f));
+		row.avatar = AddImage(0, 10, 0, AVATAR_SIZE, AVATAR_SIZE);
+		row.time = AddText(shaderProgram, "", 435, 0, 0.25, glm::vec3(0.43f, 0.47f, 0.51f));
+		row.name = AddText(shaderProgram, "", 115, 0, 0.4, glm::vec3(1, 1, 1));
+		row.preview = AddText(shaderProgram, "", 115, 0, 0.35, glm::vec3(0.43f, 0.47f, 0.51f));
+		row.message = -1;
+		for (SceneNodeId node : { row.highlight, row.avatar, row.time, row.name, row.preview }) scene.SetVisible(node, false);
+	}
 }
 
-unsigned int roundedRectShader = 0;
-unsigned int roundedRectVAO = 0;
-unsigned int roundedRectVBO = 0;
-unsigned int CreateShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource) {
-	// Create and compile vertex shader
-	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-	glCompileShader(vertexShader);
-
-	// Check vertex shader compilation
-	int success;
-	char infoLog[512];
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cerr << "Vertex shader compilation failed:\n" << infoLog << std::endl;
+// Binds the recycled rows to the conversations in view and moves them into
+// place. A conversation keeps the same row for as long as it stays visible,
+// so scrolling only changes positions; rows rebind as they wrap around.
+void UpdateConversationRows() {
+	size_t hovered;
+	hoveredMessage = -1;
+	if (conversationList.RowAt(cursor.x, cursor.y, hovered) &&
+		cursor.y < conversationList.RowBottom(hovered) + CONVERSATION_CARD_HEIGHT) {
+		hoveredMessage = static_cast<int>(searching ? searchResults[hovered] : hovered);
 	}
 
-	// Create and compile fragment shader
-	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-	glCompileShader(fragmentShader);
+	size_t first, last;
+	conversationList.VisibleRows(first, last);
+	last = std::min(last, first + conversationRows.size());
+	for (size_t i = 0; i < conversationRows.size(); i++) {
+		ConversationRow& row = conversationRows[i];
+		// Row i shows the one conversation in [first, first + row count) whose
+		// index is i modulo the row count
+		size_t index = first + (i + conversationRows.size() - first % conversationRows.size()) % conversationRows.size();
+		bool shown = index < last;
+		for (SceneNodeId node : { row.avatar, row.time, row.name, row.preview }) scene.SetVisible(node, shown);
+		if (!shown) {
+			scene.SetVisible(row.highlight, false);
+			continue;
+		}
 
-	// Check fragment shader compilation
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cerr << "Fragment shader compilation failed:\n" << infoLog << std::endl;
-	}
+		size_t listed = searching ? searchResults[index] : index;
+		if (row.message != static_cast<int>(listed)) {
+			row.message = static_cast<int>(listed);
+			MessageView message = messages[listed];
+			char stamp[16];
+			scene.SetImage(row.avatar, avatars[message.sender]);
+			scene.SetText(row.time, StringRef(stamp, FormatMessageTime(message.timestamp, stamp, sizeof(stamp))));
+			scene.SetText(row.name, message.senderName);
+			scene.SetText(row.preview, message.body);
+		}
 
-	// Create shader program and link shaders
-	unsigned int shaderProgram = glCreateProgram();
-	glAttachShader(shaderProgram, vertexShader);
-	glAttachShader(shaderProgram, fragmentShader);
-	glLinkProgram(shaderProgram);
-
-	// Check linking errors
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cerr << "Shader program linking failed:\n" << infoLog << std::endl;
+		// The selected conversation keeps its highlight and bold name; the
+		// others show both while hovered
+		bool selected = row.message == SELECTED_MESSAGE;
+		bool highlighted = selected || row.message == hoveredMessage;
+		scene.SetColor(row.highlight, selected ? glm::vec4(0.169, 0.322, 0.471, 1.0f) : glm::vec4(0.12f, 0.17f, 0.22f, 1.0f));
+		scene.SetVisible(row.highlight, highlighted);
+		scene.SetFont(row.name, highlighted ? FONT_SEMI_BOLD : FONT_REGULAR);
+
+		float y = conversationList.RowBottom(index);
+		scene.SetPosition(row.highlight, 0, y);
+		scene.SetPosition(row.avatar, 10, y + 5);
+		scene.SetPosition(row.time, 435, y + 65);
+		scene.SetPosition(row.name, 115, y + 65);
+		scene.SetPosition(row.preview, 115, y + 30);
 	}
+}
 
-	// Clean up shaders
-	glDeleteShader(vertexShader);
-	glDeleteShader(fragmentShader);
-	// Enhanced error checking
-	glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-		std::cerr << "VERTEX SHADER COMPILATION FAILED:\n" << infoLog << std::endl;
-		return 0;
-	}
+void OnCursorMove(GLFWwindow* window, double x, double y) {
+	// GLFW reports y from the top; the scene is laid out from the bottom
+	cursor = glm::vec2(static_cast<float>(x), SCR_HEIGHT - static_cast<float>(y));
+	UpdateConversationRows();
+}
 
-	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-	if (!success) {
-		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-		std::cerr << "FRAGMENT SHADER COMPILATION FAILED:\n" << infoLog << std::endl;
-		return 0;
+void OnScroll(GLFWwindow* window, double x, double y) {
+	glm::vec4 viewport = conversationList.Viewport();
+	if (cursor.x < viewport.x || cursor.x >= viewport.x + viewport.z) return;
+	// Wheel up shows earlier conversations
+	conversationList.ScrollBy(-y * SCROLL_STEP);
+	if (!scrollAnimating && conversationList.Scrolling()) {
+		scrollAnimating = true;
+		scene.BeginAnimation();
 	}
+}
 
-	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-		std::cerr << "SHADER PROGRAM LINKING FAILED:\n" << infoLog << std::endl;
-		return 0;
+// Lists the conversations matching the search bar, or all of them when it is
+// empty, from the top
+void RunSearch() {
+	for (size_t message = conversationIndex.Count(); message < messages.Count(); message++) {
+		MessageView view = messages[message];
+		conversationIndex.Add({ view.senderName, view.body });
 	}
-	return shaderProgram;
+	searching = conversationIndex.Search(searchQuery, searchResults);
+
+	conversationList.Clear();
+	conversationList.AddRows(searching ? searchResults.size() : messages.Count(), CONVERSATION_ROW_HEIGHT);
+	conversationList.ScrollTo(0, false);
+	scene.SetText(searchText, searchQuery.empty() ? StringRef("Recherche...") : StringRef(searchQuery));
+	scene.SetColor(searchText, glm::vec4(searchQuery.empty() ? SEARCH_PLACEHOLDER_COLOR : glm::vec3(1.0f), 1.0f));
+	UpdateConversationRows();
 }
-void InitializeRoundedRectRenderer() {
-	// Compile shaders
-	roundedRectShader = CreateShaderProgram(roundedRectVertexShader, roundedRectFragmentShader);
-
-	// Fullscreen quad VAO
-	float vertices[] = {
-		-1.0f, -1.0f,
-		 1.0f, -1.0f,
-		-1.0f,  1.0f,
-		 1.0f,  1.0f
-	};
-
-	glGenVertexArrays(1, &roundedRectVAO);
-	glGenBuffers(1, &roundedRectVBO);
-
-	glBindVertexArray(roundedRectVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, roundedRectVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
 
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-	glEnableVertexAttribArray(0);
-
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindVertexArray(0);
+// Typing goes to the search bar, the only text field that works yet
+void OnChar(GLFWwindow* window, unsigned int codepoint) {
+	AppendCodepoint(searchQuery, codepoint);
+	RunSearch();
 }
 
-void RenderRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color) {
-	if (roundedRectShader == 0) {
-		InitializeRoundedRectRenderer();
+void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods) {
+	if (key == GLFW_KEY_F12 && action == GLFW_PRESS && traceOutput) {
+		WriteTrace(traceOutput);
+		return;
 	}
+	if (action == GLFW_RELEASE || searchQuery.empty()) return;
+	if (key == GLFW_KEY_BACKSPACE) EraseLastCodepoint(searchQuery);
+	else if (key == GLFW_KEY_ESCAPE) searchQuery.clear();
+	else return;
+	RunSearch();
+}
 
-	glUseProgram(roundedRectShader);
+void OnWindowRefresh(GLFWwindow* window) {
+	scene.Invalidate();
+}
 
-	// Set uniforms
-	glm::mat4 projection = glm::ortho(0.0f, (float)SCR_WIDTH, 0.0f, (float)SCR_HEIGHT);
-	glUniformMatrix4fv(glGetUniformLocation(roundedRectShader, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+SceneNodeId AddText(const ShaderProgram& shader, std::string text, float x, float y, float scale, glm::vec3 color,
+	FontStyle font) {
+	// Glyphs join the quad batch; the whole frame's text shares the atlas texture
+	return scene.AddText(shader.ID, text, x, y, scale, glm::vec4(color, 1.0f), font);
+}
 
-	glUniform2f(glGetUniformLocation(roundedRectShader, "uPosition"), x, y);
-	glUniform2f(glGetUniformLocation(roundedRectShader, "uSize"), width, height);
-	glUniform1f(glGetUniformLocation(roundedRectShader, "uRadius"), radius);
-	glUniform3f(glGetUniformLocation(roundedRectShader, "uColor"), color.r, color.g, color.b);
-	glUniform2f(glGetUniformLocation(roundedRectShader, "uScreenSize"), SCR_WIDTH, SCR_HEIGHT);
+SceneNodeId AddRect(float x, float y, float width, float height, glm::vec3 color) {
+	return scene.AddRect(textureShader.ID, x, y, width, height, glm::vec4(color, 1.0f));
+}
 
-	// Render fullscreen quad (shader will handle the actual shape)
-	glBindVertexArray(roundedRectVAO);
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
+SceneNodeId AddRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color) {
+	// Instanced: only the rect's bounds are rasterized, and consecutive bubbles share one draw
+	return scene.AddRoundedRect(roundedRectShader.ID, x, y, width, height, radius, glm::vec4(color, 1.0f));
 }
 
 
-void RenderProductCard(float x, float y, const Product& product) {
-	RenderTexture(textureShader, product.textureID,
+void AddProductCard(float x, float y, const Product& product) {
+	AddImage(product.image,
 		product.x, product.y, 150, 150);
 
 	// Product name
-	RenderText(shaderProgram, product.name, x, y - 25, 0.4f, glm::vec3(0.2f, 0.2f, 0.2f));
+	AddText(shaderProgram, product.name, x, y - 25, 0.4f, glm::vec3(0.2f, 0.2f, 0.2f));
 
 	// Product price
-	RenderText(shaderProgram, product.price, x, y - 48, 0.4f, glm::vec3(0.2f, 0.4f, 0.8f));
+	AddText(shaderProgram, product.price, x, y - 48, 0.4f, glm::vec3(0.2f, 0.4f, 0.8f));
 
 	// Seller info
-	RenderText(shaderProgram, "Sold by " + product.seller, x, y - 63, 0.3f, glm::vec3(0.5f, 0.5f, 0.5f));
+	AddText(shaderProgram, "Sold by " + product.seller, x, y - 63, 0.3f, glm::vec3(0.5f, 0.5f, 0.5f));
 
 	// "Add to cart" button
-	RenderRoundedRect(x + 25, y - 105, 90, 30, 15.0f, glm::vec3(0.2f, 0.4f, 0.8f));
-	RenderText(shaderProgram, "Add to Cart", x + 30, y - 95, 0.25f, glm::vec3(1.0f, 1.0f, 1.0f));
+	AddRoundedRect(x + 25, y - 105, 90, 30, 15.0f, glm::vec3(0.2f, 0.4f, 0.8f));
+	AddText(shaderProgram, "Add to Cart", x + 30, y - 95, 0.25f, glm::vec3(1.0f, 1.0f, 1.0f));
 }
\ No newline at end of file
@@ -4,199 +4,471 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <ft2build.h>
-#include FT_FREETYPE_H
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <map>
 #include <string>
 #include <vector>
 #include <stb_image.h>
+#include "../Common/batch.h"
+#include "../Common/benchmark.h"
+#include "../Common/bitmap.h"
+#include "../Common/catalog.h"
+#include "../Common/damage.h"
+#include "../Common/glstate.h"
+#include "../Common/imageatlas.h"
+#include "../Common/listview.h"
+#include "../Common/scene.h"
+#include "../Common/searchindex.h"
+#include "../Common/shader.h"
+#include "../Common/softraster.h"
+#include "../Common/text.h"
+#include "../Common/texturecache.h"
+#include "../Common/trace.h"
 // Screen dimensions
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 768;
-
-// Structure to hold character glyph data
-struct Character {
-    unsigned int TextureID; 
-    glm::ivec2   Size;      
-    glm::ivec2   Bearing;   
-    unsigned int Advance;   
-};
-
-std::map<char, Character> Characters;
-unsigned int VAO, VBO;
+const glm::vec3 BACKGROUND_COLOR(0.95f, 0.95f, 0.96f);
 
 // Shader sources
 const char* vertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+    layout (location = 1) in vec4 vertexColor;
     out vec2 TexCoords;
+    out vec4 TextColor;
 
-    uniform mat4 projection;
+    layout (std140) uniform Frame {
+        mat4 projection;
+        vec2 screenSize;
+        float time;
+    };
 
     void main()
     {
         gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
         TexCoords = vertex.zw;
+        TextColor = vertexColor;
     }
 )";
 
 const char* fragmentShaderSource = R"(
     #version 330 core
     in vec2 TexCoords;
+    in vec4 TextColor;
     out vec4 color;
 
     uniform sampler2D text;
-    uniform vec3 textColor;
 
     void main()
     {    
-        vec4 sampled = vec4(1.0, 1.0, 1.0, texture(text, TexCoords).r);
-        color = vec4(textColor, 1.0) * sampled;
+        // Signed distance field: 0.5 on the outline, antialiased over about
+        // one screen pixel whatever the text scale
+        float distance = texture(text, TexCoords).r;
+        float smoothing = fwidth(distance) * 0.7;
+        float alpha = smoothstep(0.5 - smoothing, 0.5 + smoothing, distance);
+        color = vec4(TextColor.rgb, TextColor.a * alpha);
     }
 )";
-const char* textureVertexShaderSource = R"(
+const char* roundedRectVertexShader = R"(
     #version 330 core
-    layout (location = 0) in vec4 aPosTex; // xy = position, zw = texcoords
-    
-    out vec2 TexCoords;
-    uniform mat4 projection;
-    
+    layout (location = 0) in vec2 aCorner; // unit quad corner
+    layout (location = 1) in vec4 aRect;   // per instance: x, y, width, height
+    layout (location = 2) in vec4 aColor;
+    layout (location = 3) in float aRadius;
+
+    out vec2 vLocalPos;
+    flat out vec2 vHalfSize;
+    flat out float vRadius;
+    flat out vec4 vColor;
+
+    layout (std140) uniform Frame {
+        mat4 projection;
+        vec2 screenSize;
+        float time;
+    };
+
     void main()
     {
-        gl_Position = projection * vec4(aPosTex.xy, 0.0, 1.0);
-        TexCoords = aPosTex.zw;
+        // Grow the quad by a pixel so the anti-aliased edge is not clipped
+        vec2 pos = aRect.xy - 1.0 + aCorner * (aRect.zw + 2.0);
+        vHalfSize = aRect.zw * 0.5;
+        vLocalPos = pos - (aRect.xy + vHalfSize);
+        vRadius = min(aRadius, min(vHalfSize.x, vHalfSize.y));
+        vColor = aColor;
+        gl_Position = projection * vec4(pos, 0.0, 1.0);
     }
 )";
 
-const char* textureFragmentShaderSource = R"(
+const char* roundedRectFragmentShader = R"(
     #version 330 core
+    in vec2 vLocalPos;
+    flat in vec2 vHalfSize;
+    flat in float vRadius;
+    flat in vec4 vColor;
     out vec4 FragColor;
     
-    in vec2 TexCoords;
-    uniform sampler2D textureDiffuse;
+    float roundedBoxSDF(vec2 centerPos, vec2 size, float radius) {
+        vec2 q = abs(centerPos) - size + radius;
+        return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - radius;
+    }
     
     void main()
     {
-        FragColor = texture(textureDiffuse, TexCoords);
+        float distance = roundedBoxSDF(vLocalPos, vHalfSize, vRadius);
+        
+        // One pixel wide coverage ramp instead of a hard discard
+        float coverage = clamp(0.5 - distance, 0.0, 1.0);
+        FragColor = vec4(vColor.rgb, vColor.a * coverage);
     }
 )";
-
-// Simple rectangle drawing shader
-const char* rectVertexShaderSource = R"(
+const char* textureVertexShaderSource = R"(
     #version 330 core
-    layout (location = 0) in vec2 aPos;
+    layout (location = 0) in vec4 aPosTex; // xy = position, zw = texcoords
+    layout (location = 1) in vec4 aColor;
     
-    uniform mat4 projection;
+    out vec2 TexCoords;
+    out vec4 Color;
+    layout (std140) uniform Frame {
+        mat4 projection;
+        vec2 screenSize;
+        float time;
+    };
     
     void main()
     {
-        gl_Position = projection * vec4(aPos, 0.0, 1.0);
+        gl_Position = projection * vec4(aPosTex.xy, 0.0, 1.0);
+        TexCoords = aPosTex.zw;
+        Color = aColor;
     }
 )";
 
-const char* rectFragmentShaderSource = R"(
+const char* textureFragmentShaderSource = R"(
     #version 330 core
     out vec4 FragColor;
     
-    uniform vec3 color;
+    in vec2 TexCoords;
+    in vec4 Color;
+    uniform sampler2D textureDiffuse;
     
     void main()
     {
-        FragColor = vec4(color, 1.0);
+        FragColor = texture(textureDiffuse, TexCoords) * Color;
     }
 )";
-unsigned int CreateTextureShader() {
-    unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex, 1, &textureVertexShaderSource, NULL);
-    glCompileShader(vertex);
 
-    unsigned int fragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment, 1, &textureFragmentShaderSource, NULL);
-    glCompileShader(fragment);
+// Products are read in place from the mapped catalog file, built from
+// catalog/products.csv by CatalogTool
+const char* const CATALOG_PATH = "C:/opengl/catalog/products.bin";
+ProductCatalog catalog;
+// Products share photos, one per catalog image; each is decoded when a row
+// near the viewport first needs it and again if the atlas evicted it since
+std::vector<ImageHandle> photos;
+
+ShaderProgram shaderProgram;
+ShaderProgram textureShader;
+ShaderProgram roundedRectShader;
+
+// Everything on screen, built once and redrawn only when a node changes
+Scene scene;
+// Frames are kept offscreen so each one only repaints what changed
+bool retainFrame = false;
+DamageRegion damage(SCR_WIDTH, SCR_HEIGHT);
+// "--trace <file.json>" records zones from startup; F12 writes what is in the
+// buffers so far and the rest is written on exit
+const char* traceOutput = NULL;
+const glm::vec3 BUTTON_COLOR(0.2f, 0.4f, 0.8f);
+const glm::vec3 BUTTON_HOVER_COLOR(0.13f, 0.3f, 0.66f);
+// Drawn size; photos are decoded straight to it
+const int PRODUCT_IMAGE_SIZE = 150;
+
+// The product grid only has scene nodes for the rows that fit on screen;
+// they are rebound to whichever grid row scrolls under them
+struct ProductCard {
+    SceneNodeId image, name, price, seller, button, buttonLabel;
+};
+struct ProductRow {
+    std::vector<ProductCard> cards; // one per column
+    int row; // bound grid row, -1 for none
+};
+GridView productGrid;
+std::vector<ProductRow> productRows;
+int hoveredButton = -1;
+glm::vec2 cursor(-1.0f);
+bool scrollAnimating = false;
+const int PRODUCT_COLUMNS = 4;
+const glm::vec2 PRODUCT_CELL_SIZE(300, 270);
+const float PRODUCT_GRID_TOP = 605;
+const float PRODUCT_GRID_BOTTOM = 60; // top of the footer
+const float SCROLL_STEP = 90;
+// Rows beyond each edge of the viewport whose photos are requested ahead
+const size_t PREFETCH_ROWS = 2;
+// Search over product names and sellers, built on the first keystroke so
+// opening the catalog stays cheap, and brought up to date with new products
+// before each query
+SearchIndex productIndex;
+std::string searchQuery;
+SceneNodeId searchText;
+const glm::vec3 SEARCH_PLACEHOLDER_COLOR(0.5f, 0.5f, 0.5f);
+
+// Category tabs and price bands narrow the grid down together with the
+// search bar. Each category and band has a compressed bitmap of its
+// products, built on the first click, so combining filters is a set
+// intersection rather than a pass over the catalog.
+struct FilterTab {
+    std::string label;
+    float x;
+    SceneNodeId text;
+};
+FilterTab categoryTabs[] = {
+    { "All", 50, 0 }, { "Electronics", 120, 0 }, { "Home", 300, 0 }, { "Fashion", 370, 0 }, { "Sports", 480, 0 }
+};
+struct PriceBand {
+    FilterTab tab;
+    uint32_t low, high; // hundredths of the catalog currency, high excluded
+};
+PriceBand priceBands[] = {
+    { { "< 50", 680, 0 }, 0, 5000 }, { { "50-100", 785, 0 }, 5000, 10000 },
+    { { "100-200", 880, 0 }, 10000, 20000 }, { { "200+", 985, 0 }, 20000, UINT32_MAX }
+};
+const float PRICE_BAND_GAP = 20; // at least this much between two band labels
+const size_t CATEGORY_TAB_COUNT = sizeof(categoryTabs) / sizeof(categoryTabs[0]);
+const size_t PRICE_BAND_COUNT = sizeof(priceBands) / sizeof(priceBands[0]);
+const float FILTER_BAR_BOTTOM = SCR_HEIGHT - 120;
+const float FILTER_BAR_HEIGHT = 40;
+const glm::vec3 FILTER_COLOR(0.4f, 0.4f, 0.4f);
+const glm::vec3 FILTER_SELECTED_COLOR(0.2f, 0.4f, 0.8f);
+size_t selectedCategory = 0; // "All"
+int selectedBand = -1;       // any price
+std::vector<RoaringBitmap> categoryProducts; // by catalog category id
+RoaringBitmap bandProducts[PRICE_BAND_COUNT];
+bool filtersBuilt = false;
+
+// Products in the grid while any search or filter applies, in catalog order
+std::vector<uint32_t> listedProducts;
+bool filtered = false;
+
+SceneNodeId AddText(const ShaderProgram& shader, std::string text, float x, float y, float scale, glm::vec3 color,
+    FontStyle font = FONT_REGULAR);
+SceneNodeId AddRect(float x, float y, float width, float height, glm::vec3 color);
+SceneNodeId AddRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color);
+void AddProductRows();
+void UpdateProductRows();
+size_t ListedCount();
+size_t ListedProduct(size_t item);
+void UpdateListing();
+bool BuildSampleCatalog();
+GLFWwindow* InitWindow(bool visible);
+void DrawFrame();
+void BuildScene();
+void OnCursorMove(GLFWwindow* window, double x, double y);
+void OnScroll(GLFWwindow* window, double x, double y);
+void OnMouseButton(GLFWwindow* window, int button, int action, int mods);
+void OnChar(GLFWwindow* window, unsigned int codepoint);
+void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods);
+void OnWindowRefresh(GLFWwindow* window);
+glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.0f, static_cast<float>(SCR_HEIGHT));
 
-    unsigned int program = glCreateProgram();
-    glAttachShader(program, vertex);
-    glAttachShader(program, fragment);
-    glLinkProgram(program);
 
-    glDeleteShader(vertex);
-    glDeleteShader(fragment);
+int main(int argc, char** argv) {
+    // "--software <file.png>" draws the first frame on the CPU into a PNG and
+    // exits, for machines without a GPU or a display
+    const char* softwareOutput = NULL;
+    // "--gl-stats" logs the redundant GL calls the state cache skipped
+    bool glStats = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--gl-stats") == 0) glStats = true;
+        else if (i + 1 >= argc) break;
+        else if (std::strcmp(argv[i], "--software") == 0) softwareOutput = argv[i + 1];
+        else if (std::strcmp(argv[i], "--trace") == 0) traceOutput = argv[i + 1];
+    }
+    if (traceOutput) StartTracing();
+    // "--benchmark <frames>" times that many full repaints in a hidden window
+    // (or on the CPU with --software) and exits
+    BenchmarkOptions benchmark;
+    if (!ParseBenchmarkOptions(argc, argv, benchmark)) return -1;
+    SetSoftwareRendering(softwareOutput != NULL);
+    GLFWwindow* window = NULL;
+    if (!softwareOutput) {
+        window = InitWindow(benchmark.frames == 0);
+        if (!window) return -1;
+    }
 
-    return program;
-}
-// Product structure for our mockup
-struct Product {
-    std::string name;
-    std::string price;
-    std::string seller;
-    unsigned int textureID; 
-    float x, y;
-};
+    InitImageAtlas();
+    // Images decode on worker threads and wake the loop when one is ready
+    if (window) SetImageDecodedCallback(glfwPostEmptyEvent);
+    // Decoded images are kept here so later launches skip the decode
+    SetTextureCacheDirectory("C:/opengl/cache");
 
-std::vector<Product> products;
+    // Every weight of the family is opened on demand and kept cached for the
+    // whole run
+    if (!InitFontService("C:/font/IBM_Plex_Mono")) {
+        return -1;
+    }
 
-unsigned int shaderProgram, rectShaderProgram;
-unsigned int textureShader;
-unsigned int LoadTexture(const char* path) {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
+    // Distance fields from one base size serve every text scale; glyphs are
+    // rasterized into the atlas as strings first use them
+    if (!LoadGlyphAtlas(48, GLYPH_SDF)) {
+        return -1;
+    }
 
-    int width, height, nrComponents;
-    
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
+    // Mapping reads only the header; rows fault in their pages as they show
+    if (!catalog.Open(CATALOG_PATH)) {
+        std::cerr << "ERROR::CATALOG::CANNOT_OPEN " << CATALOG_PATH << ", using sample products" << std::endl;
+        if (!BuildSampleCatalog()) {
+            return -1;
+        }
+    }
+    photos.assign(catalog.ImageCount(), 0);
+
+    BuildScene();
+
+    if (softwareOutput) {
+        bool saved = benchmark.frames > 0
+            ? RunFrameBenchmark("store", scene, SCR_WIDTH, SCR_HEIGHT, BACKGROUND_COLOR, benchmark, DrawFrame, softwareOutput)
+            : SaveSceneFrame(scene, SCR_WIDTH, SCR_HEIGHT, BACKGROUND_COLOR, softwareOutput);
+        ShutdownImageAtlas();
+        DeleteGlyphAtlas();
+        ShutdownFontService();
+        if (traceOutput) WriteTrace(traceOutput);
+        return saved ? 0 : -1;
+    }
 
-    if (data) {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
+    // Without the frame copy every frame repaints the whole window
+    retainFrame = InitFrameCopy(SCR_WIDTH, SCR_HEIGHT);
+
+    if (benchmark.frames > 0) {
+        bool passed = RunFrameBenchmark("store", scene, SCR_WIDTH, SCR_HEIGHT, BACKGROUND_COLOR, benchmark, DrawFrame);
+        ShutdownBatchRenderer();
+        ShutdownImageAtlas();
+        DeleteFrameCopy();
+        DeleteGlyphAtlas();
+        ShutdownFontService();
+        DeleteShaderProgram(shaderProgram);
+        DeleteShaderProgram(textureShader);
+        DeleteShaderProgram(roundedRectShader);
+        DeleteFrameUniforms();
+        glfwTerminate();
+        if (traceOutput) WriteTrace(traceOutput);
+        return passed ? 0 : 1;
+    }
 
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    // Repaint on input and expose only; an idle window costs nothing
+    glfwSwapInterval(1);
+    glfwSetCursorPosCallback(window, OnCursorMove);
+    glfwSetScrollCallback(window, OnScroll);
+    glfwSetMouseButtonCallback(window, OnMouseButton);
+    glfwSetCharCallback(window, OnChar);
+    glfwSetKeyCallback(window, OnKey);
+    glfwSetWindowRefreshCallback(window, OnWindowRefresh);
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    unsigned int reportedSkipped = 0;
+    double lastFrameTime = glfwGetTime();
 
-        stbi_image_free(data);
-    }
-    else {
-        std::cerr << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
+    // Main loop
+    std::vector<ImageHandle> uploadedImages;
+    while (!glfwWindowShouldClose(window)) {
+        // Smooth scrolling moves the grid a little further every frame
+        double now = glfwGetTime();
+        if (scrollAnimating) {
+            bool moving = productGrid.Step(now - lastFrameTime);
+            UpdateProductRows();
+            if (!moving) {
+                scrollAnimating = false;
+                scene.EndAnimation();
+            }
+        }
+        lastFrameTime = now;
+
+        // Finished decodes reach the atlas a few milliseconds' worth per frame
+        uploadedImages.clear();
+        UploadDecodedImages(IMAGE_UPLOAD_BUDGET_MS, uploadedImages);
+        scene.ImagesChanged(uploadedImages);
+
+        if (scene.NeedsRedraw()) {
+            DrawFrame();
+
+            // Redundant GL calls the state cache skipped, logged whenever the figure changes
+            GLStateCounters stateCounters = EndGLStateFrame();
+            if (glStats && stateCounters.Skipped() != reportedSkipped) {
+                reportedSkipped = stateCounters.Skipped();
+                PrintGLStateCounters(stateCounters);
+            }
+
+            TRACE_ZONE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
+
+        // Sleep until something happens unless an animation or an upload needs the next frame
+        if (scene.Animating() || ImageUploadsPending()) {
+            TRACE_ZONE("PollEvents");
+            glfwPollEvents();
+        }
+        else {
+            TRACE_ZONE("WaitEvents");
+            glfwWaitEvents();
+        }
     }
 
-    return textureID;
+    // Clean up
+    ShutdownBatchRenderer();
+    ShutdownImageAtlas();
+    DeleteFrameCopy();
+    DeleteGlyphAtlas();
+    ShutdownFontService();
+    DeleteShaderProgram(shaderProgram);
+    DeleteShaderProgram(textureShader);
+    DeleteShaderProgram(roundedRectShader);
+    DeleteFrameUniforms();
+
+    glfwTerminate();
+    if (traceOutput) WriteTrace(traceOutput);
+    return 0;
 }
-void RenderText(unsigned int shader, std::string text, float x, float y, float scale, glm::vec3 color);
-void RenderRect(float x, float y, float width, float height, glm::vec3 color);
-void RenderRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color);
-void RenderProductCard(float x, float y, const Product& product);
-glm::mat4 projection = glm::ortho(0.0f, static_cast<float>(SCR_WIDTH), 0.0f, static_cast<float>(SCR_HEIGHT));
 
+// Repaints what changed since the last frame into the retained frame and
+// puts it on the back buffer
+void DrawFrame() {
+    TRACE_ZONE("DrawFrame");
+    UpdateFrameUniforms(projection, glm::vec2(SCR_WIDTH, SCR_HEIGHT), static_cast<float>(glfwGetTime()));
+
+    // Repaint only the damaged parts of the retained frame
+    damage.Clear();
+    if (retainFrame) scene.CollectDamage(damage);
+    else damage.AddAll();
+    damage.Merge();
+    UpdateImageAtlas();
+    BindFrameCopy();
+    scene.Repaint(damage, BACKGROUND_COLOR);
+    PresentFrameCopy();
+}
 
-int main() {
+// Window, context and everything drawn through GL, for the windowed run;
+// benchmarks draw into a hidden one
+GLFWwindow* InitWindow(bool visible) {
     // Initialize GLFW
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
-        return -1;
+        return NULL;
     }
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, visible ? GLFW_TRUE : GLFW_FALSE);
+#ifdef _DEBUG
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GL_TRUE);
+#endif
 
     // Create window
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Marketplace Products Page", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window" << std::endl;
         glfwTerminate();
-        return -1;
+        return NULL;
     }
 
     glfwMakeContextCurrent(window);
@@ -204,381 +476,386 @@ int main() {
     // Initialize GLAD
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cerr << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        return NULL;
     }
 
     // Set viewport
     glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
     // Configure OpenGL
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    ResetGLStateCache();
+    InstallGLDebugOutput();
+    EnableBlend(true);
+    SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    // Compile and setup the text shader
-    unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Compile rectangle shader
-    vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &rectVertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-
-    fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &rectFragmentShaderSource, NULL);
-    glCompileShader(fragmentShader);
-
-    rectShaderProgram = glCreateProgram();
-    glAttachShader(rectShaderProgram, vertexShader);
-    glAttachShader(rectShaderProgram, fragmentShader);
-    glLinkProgram(rectShaderProgram);
-    textureShader = CreateTextureShader();
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    // Configure VAO/VBO for texture quads
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
-    // FreeType initialization
-    FT_Library ft;
-    if (FT_Init_FreeType(&ft)) {
-        std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-        return -1;
-    }
+    // Projection and other per-frame constants live in one shared uniform block
+    InitFrameUniforms();
 
-    FT_Face face;
-    if (FT_New_Face(ft, "C:/font/IBM_Plex_Mono/IBMPlexMono-Regular.ttf", 0, &face)) {
-        std::cerr << "ERROR::FREETYPE: Failed to load font" << std::endl;
-        return -1;
-    }
+    // Compile and setup the text shader
+    shaderProgram = CreateShaderProgram(vertexShaderSource, fragmentShaderSource);
 
-    FT_Set_Pixel_Sizes(face, 0, 48);
+    // Rects and images share the texture shader through the quad batch
+    textureShader = CreateShaderProgram(textureVertexShaderSource, textureFragmentShaderSource);
+    roundedRectShader = CreateShaderProgram(roundedRectVertexShader, roundedRectFragmentShader);
+    InitBatchRenderer();
 
     // Disable byte-alignment restriction
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    return window;
+}
 
-    // Load first 128 characters of ASCII set
-    for (unsigned char c = 0; c < 128; c++) {
-        if (FT_Load_Char(face, c, FT_LOAD_RENDER)) {
-            std::cerr << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-            continue;
-        }
-
-        // Generate texture
-        unsigned int texture;
-        glGenTextures(1, &texture);
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glTexImage2D(
-            GL_TEXTURE_2D,
-            0,
-            GL_RED,
-            face->glyph->bitmap.width,
-            face->glyph->bitmap.rows,
-            0,
-            GL_RED,
-            GL_UNSIGNED_BYTE,
-            face->glyph->bitmap.buffer
-        );
-
-        // Set texture options
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Store character for later use
-        Character character = {
-            texture,
-            glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-            glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-            static_cast<unsigned int>(face->glyph->advance.x)
-        };
-        Characters.insert(std::pair<char, Character>(c, character));
-    }
-
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    // Clean up FreeType
-    FT_Done_Face(face);
-    FT_Done_FreeType(ft);
-
-    // Projection matrix (for converting to screen coordinates)
-    
-    glUseProgram(shaderProgram);
-    glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-
-    glUseProgram(rectShaderProgram);
-    glUniformMatrix4fv(glGetUniformLocation(rectShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
-    float firstRow = 450;
-    float secondRow = 180;
-    // Create some sample products
-    products.push_back({ "Wireless Headphones", "129.99 DT", "AudioTech",LoadTexture("C:/opengl/images/wireless headphones.jpg"), 50, firstRow });
-    products.push_back({ "Smart Watch", "199.99 DT", "TechGadgets",LoadTexture("C:/opengl/images/smartwatch.jpg"), 350, firstRow });
-    products.push_back({ "Bluetooth Speaker", "79.99 DT", "SoundMaster",LoadTexture("C:/opengl/images/speaker.jpeg"), 650, firstRow });
-    products.push_back({ "Laptop Backpack", "49.99 DT", "UrbanGear",LoadTexture("C:/opengl/images/backpack.jpg"), 950, firstRow });
-    products.push_back({ "Fitness Tracker", "89.99 DT", "FitLife",LoadTexture("C:/opengl/images/fitness.jpg"), 50, secondRow });
-    products.push_back({ "Coffee Maker", "59.99 DT", "BrewPerfect",LoadTexture("C:/opengl/images/coffee.jpg"), 350, secondRow });
-    products.push_back({ "Desk Lamp", "34.99 DT", "HomeEssentials",LoadTexture("C:/opengl/images/desk.jpg"), 650, secondRow });
-    products.push_back({ "Wireless Mouse", "29.99 DT", "TechAccessories",LoadTexture("C:/opengl/images/mouse.jpg"), 950, secondRow });
-
-    // Main loop
-    while (!glfwWindowShouldClose(window)) {
-        // Clear screen
-        glClearColor(0.95f, 0.95f, 0.96f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT);
-        RenderRect(0, SCR_HEIGHT - 80, SCR_WIDTH, SCR_HEIGHT, glm::vec3(0.95f, 0.95f, 0.96f));
-        // Render header
-        RenderRect(0, SCR_HEIGHT - 80, SCR_WIDTH, 80, glm::vec3(0.2f, 0.4f, 0.8f));
-        RenderText(shaderProgram, "Marketplace", 20, SCR_HEIGHT - 50, 0.8f, glm::vec3(1.0f, 1.0f, 1.0f));
-
-        // Render search bar
-        RenderRoundedRect(SCR_WIDTH / 2 - 200, SCR_HEIGHT - 70, 400, 40, 20.0f, glm::vec3(1.0f, 1.0f, 1.0f));
-        RenderText(shaderProgram, "Search products...", SCR_WIDTH / 2 - 180, SCR_HEIGHT - 60, 0.4f, glm::vec3(0.5f, 0.5f, 0.5f));
-
-        // Render category tabs
-        RenderRect(0, SCR_HEIGHT - 120, SCR_WIDTH, 40, glm::vec3(0.9f, 0.9f, 0.9f));
-        RenderText(shaderProgram, "All", 50, SCR_HEIGHT - 110, 0.5f, glm::vec3(0.2f, 0.4f, 0.8f));
-        RenderText(shaderProgram, "Electronics", 120, SCR_HEIGHT - 110, 0.5f, glm::vec3(0.4f, 0.4f, 0.4f));
-        RenderText(shaderProgram, "Home", 300, SCR_HEIGHT - 110, 0.5f, glm::vec3(0.4f, 0.4f, 0.4f));
-        RenderText(shaderProgram, "Fashion", 370, SCR_HEIGHT - 110, 0.5f, glm::vec3(0.4f, 0.4f, 0.4f));
-        RenderText(shaderProgram, "Sports", 480, SCR_HEIGHT - 110, 0.5f, glm::vec3(0.4f, 0.4f, 0.4f));
-
-        // Render page title
-        RenderText(shaderProgram, "Popular Products", 50, 615, 0.65f, glm::vec3(0.2f, 0.2f, 0.2f));
-
-        // Render all products
-        for (const auto& product : products) {
-            RenderProductCard(product.x, product.y, product);
-        }
-
-        // Render footer
-        RenderRect(0, 0, SCR_WIDTH, 60, glm::vec3(0.9f, 0.9f, 0.9f));
-        RenderText(shaderProgram, "Home", 50, 20, 0.4f, glm::vec3(0.2f, 0.4f, 0.8f));
-        RenderText(shaderProgram, "Search", 150, 20, 0.4f, glm::vec3(0.4f, 0.4f, 0.4f));
-        RenderText(shaderProgram, "Cart", 250, 20, 0.4f, glm::vec3(0.4f, 0.4f, 0.4f));
-        RenderText(shaderProgram, "Profile", 350, 20, 0.4f, glm::vec3(0.4f, 0.4f, 0.4f));
-
-        // Swap buffers and poll events
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+void BuildScene() {
+    // Product grid; rows scrolled past its edges slide under the title and
+    // the footer, which are painted over them
+    productGrid.SetViewport(glm::vec4(0, PRODUCT_GRID_BOTTOM, SCR_WIDTH, PRODUCT_GRID_TOP - PRODUCT_GRID_BOTTOM));
+    productGrid.SetLayout(PRODUCT_COLUMNS, PRODUCT_CELL_SIZE);
+    productGrid.SetItemCount(catalog.Count());
+    AddProductRows();
+    UpdateProductRows();
+
+    AddRect(0, PRODUCT_GRID_TOP, SCR_WIDTH, SCR_HEIGHT - PRODUCT_GRID_TOP, glm::vec3(0.95f, 0.95f, 0.96f));
+    // Render header
+    AddRect(0, SCR_HEIGHT - 80, SCR_WIDTH, 80, glm::vec3(0.2f, 0.4f, 0.8f));
+    AddText(shaderProgram, "Marketplace", 20, SCR_HEIGHT - 50, 0.8f, glm::vec3(1.0f, 1.0f, 1.0f), FONT_SEMI_BOLD);
+
+    // Render search bar
+    AddRoundedRect(SCR_WIDTH / 2 - 200, SCR_HEIGHT - 70, 400, 40, 20.0f, glm::vec3(1.0f, 1.0f, 1.0f));
+    searchText = AddText(shaderProgram, "Search products...", SCR_WIDTH / 2 - 180, SCR_HEIGHT - 60, 0.4f, SEARCH_PLACEHOLDER_COLOR);
+
+    // Render category tabs and price filters
+    AddRect(0, FILTER_BAR_BOTTOM, SCR_WIDTH, FILTER_BAR_HEIGHT, glm::vec3(0.9f, 0.9f, 0.9f));
+    for (size_t i = 0; i < CATEGORY_TAB_COUNT; i++) {
+        FilterTab& tab = categoryTabs[i];
+        tab.text = AddText(shaderProgram, tab.label, tab.x, SCR_HEIGHT - 110, 0.5f,
+            i == selectedCategory ? FILTER_SELECTED_COLOR : FILTER_COLOR);
+    }
+    // The open-ended bands name the catalog's currency, as the prices do; a
+    // long currency name pushes the later bands right
+    StringRef currency = catalog.Currency();
+    float nextBandX = 0;
+    for (size_t i = 0; i < PRICE_BAND_COUNT; i++) {
+        FilterTab& tab = priceBands[i].tab;
+        if ((i == 0 || i + 1 == PRICE_BAND_COUNT) && !currency.Empty()) tab.label += " " + currency.Str();
+        tab.x = std::max(tab.x, nextBandX);
+        glm::vec4 bounds = MeasureText(tab.label, tab.x, 0, 0.4f);
+        nextBandX = bounds.x + bounds.z + PRICE_BAND_GAP;
+        tab.text = AddText(shaderProgram, tab.label, tab.x, SCR_HEIGHT - 108, 0.4f, FILTER_COLOR);
     }
 
-    // Clean up
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteProgram(shaderProgram);
-    glDeleteProgram(rectShaderProgram);
+    // Render page title
+    AddText(shaderProgram, "Popular Products", 50, 615, 0.65f, glm::vec3(0.2f, 0.2f, 0.2f), FONT_SEMI_BOLD);
 
-    glfwTerminate();
-    return 0;
+    // Render footer
+    AddRect(0, 0, SCR_WIDTH, 60, glm::vec3(0.9f, 0.9f, 0.9f));
+    AddText(shaderProgram, "Home", 50, 20, 0.4f, glm::vec3(0.2f, 0.4f, 0.8f));
+    AddText(shaderProgram, "Search", 150, 20, 0.4f, glm::vec3(0.4f, 0.4f, 0.4f));
+    AddText(shaderProgram, "Cart", 250, 20, 0.4f, glm::vec3(0.4f, 0.4f, 0.4f));
+    AddText(shaderProgram, "Profile", 350, 20, 0.4f, glm::vec3(0.4f, 0.4f, 0.4f));
 }
-void RenderTexture(unsigned int texture, float x, float y, float width, float height) {
-    glUseProgram(rectShaderProgram);
-    glUniform3f(glGetUniformLocation(rectShaderProgram, "color"), 1.0f, 1.0f, 1.0f);
-
-    float vertices[] = {
-        x, y, 0.0f, 0.0f,
-        x, y + height, 0.0f, 1.0f,
-        x + width, y + height, 1.0f, 1.0f,
-        x + width, y, 1.0f, 0.0f
-    };
-
-    unsigned int indices[] = {
-        0, 1, 2,
-        0, 2, 3
-    };
-
-    unsigned int texVAO, texVBO, texEBO;
-    glGenVertexArrays(1, &texVAO);
-    glGenBuffers(1, &texVBO);
-    glGenBuffers(1, &texEBO);
 
-    glBindVertexArray(texVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, texVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, texEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+void OnCursorMove(GLFWwindow* window, double x, double y) {
+    // GLFW reports y from the top; the scene is laid out from the bottom
+    cursor = glm::vec2(static_cast<float>(x), SCR_HEIGHT - static_cast<float>(y));
+    UpdateProductRows();
+}
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+void OnScroll(GLFWwindow* window, double x, double y) {
+    // Wheel up shows earlier rows
+    productGrid.ScrollBy(-y * SCROLL_STEP);
+    if (!scrollAnimating && productGrid.Scrolling()) {
+        scrollAnimating = true;
+        scene.BeginAnimation();
+    }
+}
 
-    glDeleteVertexArrays(1, &texVAO);
-    glDeleteBuffers(1, &texVBO);
-    glDeleteBuffers(1, &texEBO);
+// Splits the catalog by category and price band in one pass. Products are
+// added in order, so every bitmap only ever appends.
+void BuildFilters() {
+    categoryProducts.assign(catalog.CategoryCount(), RoaringBitmap());
+    for (size_t i = 0; i < catalog.Count(); i++) {
+        const CatalogProduct& product = catalog.Product(i);
+        if (product.category < categoryProducts.size()) categoryProducts[product.category].Add(static_cast<uint32_t>(i));
+        for (size_t band = 0; band < PRICE_BAND_COUNT; band++) {
+            if (product.price >= priceBands[band].low && product.price < priceBands[band].high) {
+                bandProducts[band].Add(static_cast<uint32_t>(i));
+            }
+        }
+    }
+    filtersBuilt = true;
 }
-void RenderTexture(unsigned int textureShader, unsigned int texture,
-    float x, float y, float width, float height) {
-    glUseProgram(textureShader);
-    glUniformMatrix4fv(glGetUniformLocation(textureShader, "projection"),
-        1, GL_FALSE, glm::value_ptr(projection));
-
-    float vertices[] = {
-        // positions     // texture coords (flipped vertically)
-        x, y,           0.0f, 1.0f,  // Changed from 0.0f, 0.0f
-        x, y + height,  0.0f, 0.0f,  // Changed from 0.0f, 1.0f
-        x + width, y + height, 1.0f, 0.0f,  // Changed from 1.0f, 1.0f
-        x + width, y,    1.0f, 1.0f   // Changed from 1.0f, 0.0f
-    };
 
-    unsigned int indices[] = {
-        0, 1, 2,
-        0, 2, 3
-    };
+// Bitmap of the products in the selected category tab, empty when the
+// catalog has no category of that name
+const RoaringBitmap& CategoryFilter() {
+    static const RoaringBitmap none;
+    StringRef label = categoryTabs[selectedCategory].label;
+    for (size_t category = 0; category < categoryProducts.size(); category++) {
+        if (catalog.CategoryName(static_cast<uint32_t>(category)) == label) return categoryProducts[category];
+    }
+    return none;
+}
 
-    unsigned int VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+// Lists the products that match the search bar, the category tab and the
+// price band, or the whole catalog when none applies, from the top
+void UpdateListing() {
+    bool searching = false;
+    if (!searchQuery.empty()) {
+        for (size_t product = productIndex.Count(); product < catalog.Count(); product++) {
+            productIndex.Add({ catalog.Name(product), catalog.SellerName(catalog.Product(product).seller) });
+        }
+        searching = productIndex.Search(searchQuery, listedProducts);
+    }
 
-    glBindVertexArray(VAO);
+    // Filters intersect as bitmaps; search results join them as one more
+    bool filtering = selectedCategory > 0 || selectedBand >= 0;
+    if (filtering) {
+        if (!filtersBuilt) BuildFilters();
+        RoaringBitmap combined;
+        const RoaringBitmap* filter = nullptr;
+        if (selectedCategory > 0) filter = &CategoryFilter();
+        if (selectedBand >= 0) {
+            if (filter) {
+                combined = RoaringBitmap::And(*filter, bandProducts[selectedBand]);
+                filter = &combined;
+            }
+            else {
+                filter = &bandProducts[selectedBand];
+            }
+        }
+        if (searching) {
+            RoaringBitmap matches;
+            for (uint32_t product : listedProducts) matches.Add(product);
+            RoaringBitmap::And(matches, *filter).ToVector(listedProducts);
+        }
+        else {
+            filter->ToVector(listedProducts);
+        }
+    }
+    filtered = searching || filtering;
+
+    productGrid.SetItemCount(ListedCount());
+    productGrid.ScrollTo(0, false);
+    // The grid rows show other products now
+    for (ProductRow& row : productRows) row.row = -1;
+    scene.SetText(searchText, searchQuery.empty() ? StringRef("Search products...") : StringRef(searchQuery));
+    scene.SetColor(searchText, glm::vec4(searchQuery.empty() ? SEARCH_PLACEHOLDER_COLOR : glm::vec3(0.2f), 1.0f));
+    for (size_t i = 0; i < CATEGORY_TAB_COUNT; i++) {
+        scene.SetColor(categoryTabs[i].text, glm::vec4(i == selectedCategory ? FILTER_SELECTED_COLOR : FILTER_COLOR, 1.0f));
+    }
+    for (size_t band = 0; band < PRICE_BAND_COUNT; band++) {
+        bool selected = static_cast<int>(band) == selectedBand;
+        scene.SetColor(priceBands[band].tab.text, glm::vec4(selected ? FILTER_SELECTED_COLOR : FILTER_COLOR, 1.0f));
+    }
+    UpdateProductRows();
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+// Whether the cursor is over a filter label; the whole height of the bar counts
+bool OverFilter(const FilterTab& tab, float scale) {
+    glm::vec4 bounds = MeasureText(tab.label, tab.x, 0, scale);
+    return cursor.x >= bounds.x && cursor.x < bounds.x + bounds.z && cursor.y >= FILTER_BAR_BOTTOM &&
+        cursor.y < FILTER_BAR_BOTTOM + FILTER_BAR_HEIGHT;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+void OnMouseButton(GLFWwindow* window, int button, int action, int mods) {
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) return;
+    for (size_t i = 0; i < CATEGORY_TAB_COUNT; i++) {
+        if (OverFilter(categoryTabs[i], 0.5f)) {
+            selectedCategory = i;
+            UpdateListing();
+            return;
+        }
+    }
+    // A second click on the selected band clears it
+    for (size_t band = 0; band < PRICE_BAND_COUNT; band++) {
+        if (OverFilter(priceBands[band].tab, 0.4f)) {
+            selectedBand = selectedBand == static_cast<int>(band) ? -1 : static_cast<int>(band);
+            UpdateListing();
+            return;
+        }
+    }
+}
 
-    // Position attribute
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
+// Typing goes to the search bar, the only text field
+void OnChar(GLFWwindow* window, unsigned int codepoint) {
+    AppendCodepoint(searchQuery, codepoint);
+    UpdateListing();
+}
 
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture);
+void OnKey(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS && traceOutput) {
+        WriteTrace(traceOutput);
+        return;
+    }
+    if (action == GLFW_RELEASE || searchQuery.empty()) return;
+    if (key == GLFW_KEY_BACKSPACE) EraseLastCodepoint(searchQuery);
+    else if (key == GLFW_KEY_ESCAPE) searchQuery.clear();
+    else return;
+    UpdateListing();
+}
 
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+void OnWindowRefresh(GLFWwindow* window) {
+    scene.Invalidate();
+}
 
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+SceneNodeId AddImage(ImageHandle image, float x, float y, float width, float height) {
+    // Atlas images share one page texture, so a whole grid batches into one draw
+    return scene.AddAtlasImage(textureShader.ID, image, x, y, width, height);
 }
 
-void RenderText(unsigned int shader, std::string text, float x, float y, float scale, glm::vec3 color) {
-    // Activate corresponding render state
-    glUseProgram(shader);
-    glUniform3f(glGetUniformLocation(shader, "textColor"), color.x, color.y, color.z);
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(VAO);
-
-    // Iterate through all characters
-    std::string::const_iterator c;
-    for (c = text.begin(); c != text.end(); c++) {
-        Character ch = Characters[*c];
-
-        float xpos = x + ch.Bearing.x * scale;
-        float ypos = y - (ch.Size.y - ch.Bearing.y) * scale;
-
-        float w = ch.Size.x * scale;
-        float h = ch.Size.y * scale;
-
-        // Update VBO for each character
-        float vertices[6][4] = {
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos,     ypos,       0.0f, 1.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-
-            { xpos,     ypos + h,   0.0f, 0.0f },
-            { xpos + w, ypos,       1.0f, 1.0f },
-            { xpos + w, ypos + h,   1.0f, 0.0f }
-        };
-
-        // Render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // Now advance cursors for next glyph
-        x += (ch.Advance >> 6) * scale;
-    }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+SceneNodeId AddText(const ShaderProgram& shader, std::string text, float x, float y, float scale, glm::vec3 color,
+    FontStyle font) {
+    // Glyphs join the quad batch; the whole frame's text shares the atlas texture
+    return scene.AddText(shader.ID, text, x, y, scale, glm::vec4(color, 1.0f), font);
 }
 
-void RenderRect(float x, float y, float width, float height, glm::vec3 color) {
-    glUseProgram(rectShaderProgram);
-    glUniform3f(glGetUniformLocation(rectShaderProgram, "color"), color.x, color.y, color.z);
+SceneNodeId AddRect(float x, float y, float width, float height, glm::vec3 color) {
+    return scene.AddRect(textureShader.ID, x, y, width, height, glm::vec4(color, 1.0f));
+}
 
-    float vertices[] = {
-        x, y,
-        x, y + height,
-        x + width, y + height,
-        x + width, y
+SceneNodeId AddRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color) {
+    // Instanced SDF rounded rect, batched with the rest of the frame
+    return scene.AddRoundedRect(roundedRectShader.ID, x, y, width, height, radius, glm::vec4(color, 1.0f));
+}
+// The sample products, for running without a catalog file. Large catalogs
+// for checking how the grid scales come from CatalogTool --pad.
+bool BuildSampleCatalog() {
+    static const char* const sellers[] = {
+        "AudioTech", "TechGadgets", "SoundMaster", "UrbanGear", "FitLife", "BrewPerfect", "HomeEssentials", "TechAccessories"
     };
-
-    unsigned int indices[] = {
-        0, 1, 2,
-        0, 2, 3
+    static const char* const categories[] = {
+        "Electronics", "Electronics", "Electronics", "Fashion", "Sports", "Home", "Home", "Electronics"
     };
+    static const char* const images[] = {
+        "C:/opengl/images/wireless headphones.jpg", "C:/opengl/images/smartwatch.jpg", "C:/opengl/images/speaker.jpeg",
+        "C:/opengl/images/backpack.jpg", "C:/opengl/images/fitness.jpg", "C:/opengl/images/coffee.jpg",
+        "C:/opengl/images/desk.jpg", "C:/opengl/images/mouse.jpg"
+    };
+    CatalogBuilder builder;
+    builder.SetCurrency("DT");
+    builder.Add("Wireless Headphones", 12999, sellers[0], categories[0], images[0]);
+    builder.Add("Smart Watch", 19999, sellers[1], categories[1], images[1]);
+    builder.Add("Bluetooth Speaker", 7999, sellers[2], categories[2], images[2]);
+    builder.Add("Laptop Backpack", 4999, sellers[3], categories[3], images[3]);
+    builder.Add("Fitness Tracker", 8999, sellers[4], categories[4], images[4]);
+    builder.Add("Coffee Maker", 5999, sellers[5], categories[5], images[5]);
+    builder.Add("Desk Lamp", 3499, sellers[6], categories[6], images[6]);
+    builder.Add("Wireless Mouse", 2999, sellers[7], categories[7], images[7]);
+
+    std::vector<unsigned char> bytes;
+    builder.Write(bytes);
+    return catalog.Adopt(std::move(bytes));
+}
 
-    unsigned int rectVAO, rectVBO, rectEBO;
-    glGenVertexArrays(1, &rectVAO);
-    glGenBuffers(1, &rectVBO);
-    glGenBuffers(1, &rectEBO);
-
-    glBindVertexArray(rectVAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, rectVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, rectEBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-    glDeleteVertexArrays(1, &rectVAO);
-    glDeleteBuffers(1, &rectVBO);
-    glDeleteBuffers(1, &rectEBO);
+// Products in the grid: the listing while a search or filter applies, else
+// the whole catalog
+size_t ListedCount() {
+    return filtered ? listedProducts.size() : catalog.Count();
+}
+size_t ListedProduct(size_t item) {
+    return filtered ? listedProducts[item] : item;
 }
 
-void RenderRoundedRect(float x, float y, float width, float height, float radius, glm::vec3 color) {
-    // For simplicity, we'll just render a regular rectangle in this example
-    // A proper rounded rectangle would require more complex geometry or a shader
-    RenderRect(x, y, width, height, color);
+// Photo of a product, requested again if it was never loaded or was evicted.
+// Resolving counts as a use, so rows about to scroll in keep their photos.
+ImageHandle RequestPhoto(uint32_t photo) {
+    if (photo >= photos.size()) return 0;
+    unsigned int texture;
+    glm::vec4 uv;
+    if (!photos[photo] || !ResolveAtlasImage(photos[photo], texture, uv)) {
+        photos[photo] = LoadAtlasImageAsync(catalog.ImagePath(photo).Str().c_str(), PRODUCT_IMAGE_SIZE, PRODUCT_IMAGE_SIZE);
+    }
+    return photos[photo];
 }
-void RenderProductCard(float x, float y, const Product& product) {
-    RenderTexture(textureShader, product.textureID,
-        product.x, product.y, 150, 150);
 
-    // Product name
-    RenderText(shaderProgram, product.name, x, y - 25, 0.4f, glm::vec3(0.2f, 0.2f, 0.2f));
+void AddProductRows() {
+    // Enough rows to cover the viewport with one cut at each edge
+    size_t count = static_cast<size_t>(std::ceil(productGrid.Viewport().w / PRODUCT_CELL_SIZE.y)) + 1;
+    productRows.resize(count);
+    for (ProductRow& row : productRows) {
+        row.row = -1;
+        row.cards.resize(PRODUCT_COLUMNS);
+        for (ProductCard& card : row.cards) {
+            card.image = AddImage(0, 0, 0, PRODUCT_IMAGE_SIZE, PRODUCT_IMAGE_SIZE);
+            card.name = AddText(shaderProgram, "", 0, 0, 0.4f, glm::vec3(0.2f, 0.2f, 0.2f));
+            card.price = AddText(shaderProgram, "", 0, 0, 0.4f, glm::vec3(0.2f, 0.4f, 0.8f));
+            card.seller = AddText(shaderProgram, "", 0, 0, 0.3f, glm::vec3(0.5f, 0.5f, 0.5f));
+            card.button = AddRoundedRect(0, 0, 90, 30, 15.0f, BUTTON_COLOR);
+            card.buttonLabel = AddText(shaderProgram, "Add to Cart", 0, 0, 0.25f, glm::vec3(1.0f, 1.0f, 1.0f));
+            for (SceneNodeId node : { card.image, card.name, card.price, card.seller, card.button, card.buttonLabel }) {
+                scene.SetVisible(node, false);
+            }
+        }
+    }
+}
 
-    // Product price
-    RenderText(shaderProgram, product.price, x, y - 48, 0.4f, glm::vec3(0.2f, 0.4f, 0.8f));
+// Binds the recycled rows to the grid rows in view and moves them into
+// place. A grid row keeps the same scene row for as long as it stays
+// visible, so scrolling only changes positions; rows rebind as they wrap
+// around. Photos of the rows just outside the viewport are requested early.
+void UpdateProductRows() {
+    size_t hovered;
+    hoveredButton = -1;
+    if (productGrid.ItemAt(cursor.x, cursor.y, hovered)) {
+        glm::vec2 origin = productGrid.CellOrigin(hovered);
+        if (cursor.x >= origin.x + 75 && cursor.x < origin.x + 165 && cursor.y >= origin.y + 10 && cursor.y < origin.y + 40) {
+            hoveredButton = static_cast<int>(hovered);
+        }
+    }
 
-    // Seller info
-    RenderText(shaderProgram, "Sold by " + product.seller, x, y - 63, 0.3f, glm::vec3(0.5f, 0.5f, 0.5f));
+    size_t first, last;
+    productGrid.VisibleRows(first, last);
+    last = std::min(last, first + productRows.size());
+    for (size_t i = 0; i < productRows.size(); i++) {
+        ProductRow& row = productRows[i];
+        // Row i shows the one grid row in [first, first + row count) whose
+        // index is i modulo the row count
+        size_t index = first + (i + productRows.size() - first % productRows.size()) % productRows.size();
+        bool rebind = row.row != static_cast<int>(index);
+        row.row = index < last ? static_cast<int>(index) : -1;
+
+        float y = productGrid.RowBottom(index);
+        for (int column = 0; column < PRODUCT_COLUMNS; column++) {
+            ProductCard& card = row.cards[column];
+            size_t item = index * PRODUCT_COLUMNS + column;
+            bool shown = index < last && item < ListedCount();
+            for (SceneNodeId node : { card.image, card.name, card.price, card.seller, card.button, card.buttonLabel }) {
+                scene.SetVisible(node, shown);
+            }
+            if (!shown) continue;
+
+            size_t listed = ListedProduct(item);
+            const CatalogProduct& product = catalog.Product(listed);
+            if (rebind) {
+                char text[128];
+                scene.SetText(card.name, catalog.Name(listed));
+                scene.SetText(card.price, StringRef(text, FormatPrice(product.price, catalog.Currency(), text, sizeof(text))));
+                StringRef seller = catalog.SellerName(product.seller);
+                int length = snprintf(text, sizeof(text), "Sold by %.*s", static_cast<int>(seller.size), seller.data);
+                scene.SetText(card.seller, StringRef(text, std::min(static_cast<size_t>(std::max(length, 0)), sizeof(text) - 1)));
+            }
+            // Cheap when the photo is still in the atlas
+            scene.SetImage(card.image, RequestPhoto(product.image));
+            bool buttonHovered = hoveredButton == static_cast<int>(item);
+            scene.SetColor(card.button, glm::vec4(buttonHovered ? BUTTON_HOVER_COLOR : BUTTON_COLOR, 1.0f));
+
+            float x = productGrid.CellOrigin(item).x + 50;
+            float imageY = y + 115;
+            scene.SetPosition(card.image, x, imageY);
+            scene.SetPosition(card.name, x, imageY - 25);
+            scene.SetPosition(card.price, x, imageY - 48);
+            scene.SetPosition(card.seller, x, imageY - 63);
+            scene.SetPosition(card.button, x + 25, imageY - 105);
+            scene.SetPosition(card.buttonLabel, x + 30, imageY - 95);
+        }
+    }
 
-    // "Add to cart" button
-    RenderRoundedRect(x+25, y - 105, 90, 30, 15.0f, glm::vec3(0.2f, 0.4f, 0.8f));
-    RenderText(shaderProgram, "Add to Cart", x+30, y - 95, 0.25f, glm::vec3(1.0f, 1.0f, 1.0f));
-}
\ No newline at end of file
+    // Rows about to scroll in have their photos decoding before they show
+    size_t prefetchFirst, prefetchLast;
+    productGrid.VisibleRows(prefetchFirst, prefetchLast, PREFETCH_ROWS);
+    for (size_t index = prefetchFirst; index < prefetchLast; index++) {
+        if (index >= first && index < last) continue;
+        for (size_t item = index * PRODUCT_COLUMNS; item < std::min((index + 1) * PRODUCT_COLUMNS, ListedCount()); item++) {
+            RequestPhoto(catalog.Product(ListedProduct(item)).image);
+        }
+    }
+}
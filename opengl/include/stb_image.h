@@ -524,6 +524,14 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// (local addition) decode JPEGs at 1/2, 1/4 or 1/8 size by running a reduced
+// inverse DCT on each block: the smallest of those that is still at least
+// min_width x min_height, or full size when none is. The size returned in
+// *x and *y is the reduced one; stbi_info still reports the full size.
+// 0, 0 (the default) always decodes at full size.
+STBIDEF void stbi_set_jpeg_min_size_on_load(int min_width, int min_height);
+STBIDEF void stbi_set_jpeg_min_size_on_load_thread(int min_width, int min_height);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -1134,6 +1142,31 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+static int stbi__jpeg_min_width_global = 0, stbi__jpeg_min_height_global = 0;
+
+STBIDEF void stbi_set_jpeg_min_size_on_load(int min_width, int min_height)
+{
+   stbi__jpeg_min_width_global = min_width;
+   stbi__jpeg_min_height_global = min_height;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_min_width   stbi__jpeg_min_width_global
+#define stbi__jpeg_min_height  stbi__jpeg_min_height_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_min_width_local, stbi__jpeg_min_height_local, stbi__jpeg_min_size_set;
+
+STBIDEF void stbi_set_jpeg_min_size_on_load_thread(int min_width, int min_height)
+{
+   stbi__jpeg_min_width_local = min_width;
+   stbi__jpeg_min_height_local = min_height;
+   stbi__jpeg_min_size_set = 1;
+}
+
+#define stbi__jpeg_min_width   (stbi__jpeg_min_size_set ? stbi__jpeg_min_width_local : stbi__jpeg_min_width_global)
+#define stbi__jpeg_min_height  (stbi__jpeg_min_size_set ? stbi__jpeg_min_height_local : stbi__jpeg_min_height_global)
+#endif // STBI_THREAD_LOCAL
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1993,6 +2026,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale_shift; // blocks are output at (8 >> scale_shift) pixels square
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -2464,6 +2498,50 @@ stbi_inline static stbi_uc stbi__clamp(int x)
    t1 += p2+p4;                                \
    t0 += p1+p3;
 
+// C(u) * cos((2x+1) u pi / 2n) for n = 2 and 4, row x, column u
+static const int stbi__idct_scaled_2[4] = {
+   stbi__f2f(0.707106781f), stbi__f2f( 0.707106781f),
+   stbi__f2f(0.707106781f), stbi__f2f(-0.707106781f)
+};
+static const int stbi__idct_scaled_4[16] = {
+   stbi__f2f(0.707106781f), stbi__f2f( 0.923879533f), stbi__f2f( 0.707106781f), stbi__f2f( 0.382683432f),
+   stbi__f2f(0.707106781f), stbi__f2f( 0.382683432f), stbi__f2f(-0.707106781f), stbi__f2f(-0.923879533f),
+   stbi__f2f(0.707106781f), stbi__f2f(-0.382683432f), stbi__f2f(-0.707106781f), stbi__f2f( 0.923879533f),
+   stbi__f2f(0.707106781f), stbi__f2f(-0.923879533f), stbi__f2f( 0.707106781f), stbi__f2f(-0.382683432f)
+};
+
+// reduced-size output of one block: an n-point inverse DCT (n = 1, 2 or 4)
+// of the n x n lowest coefficients, which samples the full-size block at the
+// centers of its n x n subblocks (as IJG's jidctred does)
+static void stbi__idct_block_scaled(stbi_uc *out, int out_stride, short data[64], int n)
+{
+   int i,j,k,tmp[16];
+   const int *c;
+   if (n == 1) {
+      // the DC term alone is the block's mean
+      out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+      return;
+   }
+   c = n == 2 ? stbi__idct_scaled_2 : stbi__idct_scaled_4;
+   // columns; each intermediate keeps the coefficients' own scale, which
+   // keeps the row pass inside 32 bits even for corrupt input
+   for (j=0; j < n; ++j) {
+      for (i=0; i < n; ++i) {
+         int sum = 0;
+         for (k=0; k < n; ++k) sum += c[j*n+k] * data[k*8+i];
+         tmp[j*n+i] = (sum + 2048) >> 12;
+      }
+   }
+   // rows, with the 2D transform's 1/4 and the +128 level shift
+   for (j=0; j < n; ++j, out += out_stride) {
+      for (i=0; i < n; ++i) {
+         int sum = 0;
+         for (k=0; k < n; ++k) sum += c[i*n+k] * tmp[j*n+k];
+         out[i] = stbi__clamp(((sum + (1 << 13)) >> 14) + 128);
+      }
+   }
+}
+
 static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
 {
    int i,val[64],*v=val;
@@ -2946,6 +3024,19 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// inverse DCT of the block whose top-left pixel is x, y in component n's
+// full-size plane, written to its place in the (possibly reduced) plane
+static void stbi__jpeg_idct(stbi__jpeg *z, int n, int x, int y, short data[64])
+{
+   int shift = z->scale_shift;
+   int stride = z->img_comp[n].w2 >> shift;
+   stbi_uc *out = z->img_comp[n].data + stride*(y >> shift) + (x >> shift);
+   if (shift == 0)
+      z->idct_block_kernel(out, stride, data);
+   else
+      stbi__idct_block_scaled(out, stride, data, 8 >> shift);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2964,7 +3055,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i*8, j*8, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2992,7 +3083,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        stbi__jpeg_idct(z, n, x2, y2, data);
                      }
                   }
                }
@@ -3089,7 +3180,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               stbi__jpeg_idct(z, n, i*8, j*8, data);
             }
          }
       }
@@ -3309,6 +3400,17 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       if (v_max % z->img_comp[i].v != 0) return stbi__err("bad V","Corrupt JPEG");
    }
 
+   // reduce the output while it stays at least the requested size
+   z->scale_shift = 0;
+   if (stbi__jpeg_min_width > 0 && stbi__jpeg_min_height > 0) {
+      while (z->scale_shift < 3) {
+         int shift = z->scale_shift + 1;
+         if ((int) ((s->img_x + (1u << shift) - 1) >> shift) < stbi__jpeg_min_width) break;
+         if ((int) ((s->img_y + (1u << shift) - 1) >> shift) < stbi__jpeg_min_height) break;
+         z->scale_shift = shift;
+      }
+   }
+
    // compute interleaved mcu info
    z->img_h_max = h_max;
    z->img_v_max = v_max;
@@ -3334,7 +3436,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      // w2, h2 are multiples of 8, so every scale divides them exactly
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2 >> z->scale_shift, z->img_comp[i].h2 >> z->scale_shift, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3873,6 +3976,20 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // from here on the planes and the image are their reduced size
+   if (z->scale_shift) {
+      int shift = z->scale_shift;
+      unsigned int round = (1u << shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> shift;
+      z->s->img_y = (z->s->img_y + round) >> shift;
+      for (n=0; n < z->s->img_n; ++n) {
+         z->img_comp[n].x = (z->img_comp[n].x + round) >> shift;
+         z->img_comp[n].y = (z->img_comp[n].y + round) >> shift;
+         z->img_comp[n].w2 >>= shift;
+         z->img_comp[n].h2 >>= shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 